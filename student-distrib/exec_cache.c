@@ -0,0 +1,93 @@
+#include "exec_cache.h"
+#include "lib.h"
+
+/* Executable cache
+ * Remembers the validated entry point of recently executed programs, keyed
+ * by inode number, so a repeat execute skips reading and checking the ELF
+ * header. Images themselves are not kept: their pages are read from the
+ * file system as they are touched (see task_page_fault). When the table is
+ * full, the least recently used entry is dropped.
+ */
+
+uint32_t exec_cache_hits = 0;
+uint32_t exec_cache_misses = 0;
+
+static exec_cache_entry_t exec_cache[EXEC_CACHE_ENTRIES];
+static uint32_t exec_cache_clock;
+
+/* init_exec_cache
+ *  Descrption: Mark every cache slot unused
+ *  Arg: none
+ *  RETURN: none
+ */
+void init_exec_cache(void) {
+    int i;
+    for (i = 0; i < EXEC_CACHE_ENTRIES; i ++) {
+        exec_cache[i].inode = -1;
+    }
+    exec_cache_clock = 0;
+}
+
+/* exec_cache_lookup
+ *  Descrption: Find the cached entry of a file and count the hit or miss
+ *  Arg:
+ *      inode: inode number of the program
+ *  RETURN:
+ *      the cache entry, or NULL on a miss
+ */
+exec_cache_entry_t *exec_cache_lookup(int32_t inode) {
+    int i;
+    for (i = 0; i < EXEC_CACHE_ENTRIES; i ++) {
+        if (exec_cache[i].inode == inode) {
+            exec_cache[i].last_use = ++exec_cache_clock;
+            exec_cache_hits ++;
+            return &exec_cache[i];
+        }
+    }
+    exec_cache_misses ++;
+    return NULL;
+}
+
+/* exec_cache_insert
+ *  Descrption: Record the entry point of a freshly validated program,
+ *      taking a free slot or else the least recently used one
+ *  Arg:
+ *      inode: inode number of the program
+ *      entry: the validated entry point
+ *  RETURN:
+ *      the new cache entry
+ */
+exec_cache_entry_t *exec_cache_insert(int32_t inode, uint32_t entry) {
+    int i;
+    exec_cache_entry_t *slot = NULL;
+
+    for (i = 0; i < EXEC_CACHE_ENTRIES; i ++) {
+        if (exec_cache[i].inode == -1) {
+            slot = &exec_cache[i];
+            break;
+        }
+        if (!slot || exec_cache[i].last_use < slot->last_use) {
+            slot = &exec_cache[i];
+        }
+    }
+
+    slot->inode = inode;
+    slot->entry = entry;
+    slot->last_use = ++exec_cache_clock;
+    return slot;
+}
+
+/* exec_cache_invalidate
+ *  Descrption: Drop the cached entry of a file whose contents changed
+ *  Arg:
+ *      inode: inode number of the file
+ *  RETURN: none
+ */
+void exec_cache_invalidate(int32_t inode) {
+    int i;
+    for (i = 0; i < EXEC_CACHE_ENTRIES; i ++) {
+        if (exec_cache[i].inode == inode) {
+            exec_cache[i].inode = -1;
+        }
+    }
+}
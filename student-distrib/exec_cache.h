@@ -0,0 +1,24 @@
+#ifndef _EXEC_CACHE_H_
+#define _EXEC_CACHE_H_
+
+#include "types.h"
+
+// Number of programs kept at once
+#define EXEC_CACHE_ENTRIES 16
+
+typedef struct {
+    int32_t inode;          // -1 if the slot is unused
+    uint32_t entry;         // Validated ELF entry point
+    uint32_t last_use;      // Value of exec_cache_clock on the last hit
+} exec_cache_entry_t;
+
+// Hit/miss counters; read by tests.c
+extern uint32_t exec_cache_hits;
+extern uint32_t exec_cache_misses;
+
+void init_exec_cache(void);
+exec_cache_entry_t *exec_cache_lookup(int32_t inode);
+exec_cache_entry_t *exec_cache_insert(int32_t inode, uint32_t entry);
+void exec_cache_invalidate(int32_t inode);
+
+#endif /* ifndef _EXEC_CACHE_H_ */
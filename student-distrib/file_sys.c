@@ -1,5 +1,7 @@
 #include "file_sys.h"
 #include "lib.h"
+#include "frame.h"
+#include "exec_cache.h"
 
 // File ops table
 file_ops_table_t fs_file_ops_table = {
@@ -20,6 +22,27 @@ file_ops_table_t fs_dir_ops_table = {
 static uint32_t bblock_ptr;
 static inode_t* inodes;
 static dentry_t* dentries;
+static uint8_t* data_blocks;
+/* dentry index for each name hash slot, or DENTRY_HASH_EMPTY */
+static int8_t dentry_hash[DENTRY_HASH_SIZE];
+static uint8_t dentry_hash_ready = 0;
+
+/* The boot image is kept in RAM and written in place. Its free data
+ * blocks and inodes can be reused, and files grow into overlay blocks
+ * numbered after the image's own. A bit is set in block_bitmap for every
+ * block in use */
+static uint32_t img_block_count;
+static uint32_t block_bitmap[FS_BLOCK_MAX / 32];
+static uint32_t block_hint = 0;
+static uint8_t* overlay_chunks[FS_BLOCK_MAX / FS_CHUNK_BLOCKS];
+static uint8_t inode_used[FS_INODE_MAX];
+
+#define BLOCK_USED(b) (block_bitmap[(b) / 32] & (1 << ((b) % 32)))
+
+static uint32_t fn_hash(const int8_t* fname);
+static void dentry_hash_insert(uint32_t index);
+static void build_dentry_hash(void);
+static void build_block_bitmap(void);
 
 /* Function: fs_init;
  * Inputs: boot_ptr - the ptr the boot block
@@ -30,6 +53,150 @@ void fs_init(uint32_t boot_ptr){
     bblock_ptr = boot_ptr;
     dentries = (dentry_t*)(bblock_ptr + BBLOCK_DENTRIES_OFF);
     inodes = (inode_t*)(bblock_ptr + BLOCK_SIZE);
+    /* data blocks start right after the boot block and the inode blocks */
+    data_blocks = (uint8_t*)(bblock_ptr + BLOCK_SIZE
+            + *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF)) * BLOCK_SIZE);
+    build_dentry_hash();
+    build_block_bitmap();
+}
+
+/* Function: build_block_bitmap
+ * Inputs: None
+ * Return Value: None
+ * Function: Marks the inodes of the files in the image and their data
+ *           blocks as used; everything else is free for writes
+ */
+static void build_block_bitmap(void){
+    uint32_t num_dentries = *(uint32_t*)(bblock_ptr);
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    uint32_t i, j, b, inode_num;
+
+    img_block_count = *((uint32_t*)(bblock_ptr + BBLOCK_DATA_COUNT_OFF));
+    memset(block_bitmap, 0, sizeof(block_bitmap));
+    memset(inode_used, 0, sizeof(inode_used));
+
+    if(num_dentries > MAX_FILE_NUM)
+        num_dentries = MAX_FILE_NUM;
+
+    for(i = 0; i < num_dentries; i++){
+        inode_num = dentries[i].inode_num;
+        if(dentries[i].filetype != FILE_TYPE_REG || inode_num >= inode_count)
+            continue;
+        if(inode_num < FS_INODE_MAX)
+            inode_used[inode_num] = 1;
+        for(j = 0; j * BLOCK_SIZE < inodes[inode_num].file_size; j++){
+            b = inodes[inode_num].data_blocks[j];
+            if(b < FS_BLOCK_MAX)
+                block_bitmap[b / 32] |= 1 << (b % 32);
+        }
+    }
+}
+
+/* Function: fs_block
+ * Inputs: block - a data block number
+ * Return Value: Pointer to the block, NULL if its overlay chunk is missing
+ * Function: Maps a block number to memory. Image blocks follow the inodes;
+ *           overlay blocks live in chunks obtained by block_alloc
+ */
+static uint8_t* fs_block(uint32_t block){
+    uint8_t* chunk;
+    if(block < img_block_count)
+        return data_blocks + block * BLOCK_SIZE;
+    block -= img_block_count;
+    chunk = overlay_chunks[block / FS_CHUNK_BLOCKS];
+    return chunk ? chunk + (block % FS_CHUNK_BLOCKS) * BLOCK_SIZE : NULL;
+}
+
+/* Function: block_alloc
+ * Inputs: want - the block number to try first
+ * Return Value: The block number allocated, -1 if the file system is full
+ * Function: Takes the first free block from `want' on. Files pass the block
+ *           after their last one, so appends extend a contiguous extent
+ *           that read_data copies in one go. Backs overlay blocks with
+ *           frames on first use
+ */
+static int32_t block_alloc(uint32_t want){
+    uint32_t i, b;
+    for(i = 0; i < FS_BLOCK_MAX; i++){
+        b = (want + i) % FS_BLOCK_MAX;
+        if(BLOCK_USED(b))
+            continue;
+        if(!fs_block(b)){
+            uint32_t chunk = frame_alloc_contig(FS_CHUNK_BLOCKS);
+            if(!chunk)
+                continue;
+            overlay_chunks[(b - img_block_count) / FS_CHUNK_BLOCKS] = (uint8_t*)chunk;
+        }
+        block_bitmap[b / 32] |= 1 << (b % 32);
+        block_hint = b + 1;
+        return (int32_t)b;
+    }
+    return -1;
+}
+
+/* Function: block_free
+ * Inputs: block - a block number from block_alloc
+ * Return Value: None
+ * Function: Returns a block to the bitmap; overlay chunks are kept
+ */
+static void block_free(uint32_t block){
+    block_bitmap[block / 32] &= ~(1 << (block % 32));
+}
+
+/* Function: fn_hash
+ * Inputs: fname - the file name
+ * Return Value: FNV-1a hash of the first MAX_NAME_LENGTH bytes of the name
+ * Function: Hashes a name the same way strncmp compares it in the lookup, so
+ *           names that only differ past MAX_NAME_LENGTH land in the same slot
+ */
+static uint32_t fn_hash(const int8_t* fname){
+    uint32_t hash = 2166136261U;
+    uint32_t i;
+    for(i = 0; i < MAX_NAME_LENGTH && fname[i] != '\0'; i++){
+        hash ^= (uint8_t)fname[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/* Function: build_dentry_hash
+ * Inputs: None
+ * Return Value: None
+ * Function: Fills the name index from the boot block dentries with linear
+ *           probing. The first dentry with a given name wins, which matches
+ *           the order of the linear scan
+ */
+static void build_dentry_hash(void){
+    uint32_t num_dentries = *(uint32_t*)(bblock_ptr);
+    uint32_t i, slot;
+
+    for(slot = 0; slot < DENTRY_HASH_SIZE; slot++){
+        dentry_hash[slot] = DENTRY_HASH_EMPTY;
+    }
+
+    if(num_dentries > MAX_FILE_NUM)
+        num_dentries = MAX_FILE_NUM;
+
+    for(i = 0; i < num_dentries; i++){
+        dentry_hash_insert(i);
+    }
+    dentry_hash_ready = 1;
+}
+
+/* Function: dentry_hash_insert
+ * Inputs: index - the dentry to add
+ * Return Value: None
+ * Function: Adds a dentry to the name index unless an earlier dentry has
+ *           the same name
+ */
+static void dentry_hash_insert(uint32_t index){
+    uint32_t slot = fn_hash(dentries[index].filename) & (DENTRY_HASH_SIZE - 1);
+    while(dentry_hash[slot] != DENTRY_HASH_EMPTY){
+        if(!strncmp(dentries[(int)dentry_hash[slot]].filename, dentries[index].filename, MAX_NAME_LENGTH))
+            return;
+        slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+    }
+    dentry_hash[slot] = (int8_t)index;
 }
 
 
@@ -76,10 +243,16 @@ int fs_file_read(int8_t* buf, uint32_t length, FILE *file){
 /* Function: fs_file_write;
  * Inputs: buf - the buffer we want to write the file data to
  *         length - the number of bytes we want to write
- * Return Value: -1
- * Function: Nothing
+ * Return Value: The number of bytes written, -1 if none could be
+ * Function: Writes at the current position and moves past the data
  */
-int fs_file_write(const int8_t* buf, uint32_t length, FILE *file){ return -1; }
+int fs_file_write(const int8_t* buf, uint32_t length, FILE *file){
+    int bytes_written = (int)write_data(file->inode, file->pos, buf, length);
+    if (bytes_written > 0) {
+        file->pos += bytes_written;
+    }
+    return bytes_written;
+}
 
 /* Function: fs_file_close;
  * Inputs: filename - the file name we want to close
@@ -91,6 +264,48 @@ int fs_file_close(FILE *file){
 }
 
 
+/* Function: fs_file_lseek;
+ * Inputs: offset - where to move to, relative to `whence'
+ *         whence - SEEK_SET, SEEK_CUR or SEEK_END
+ * Return Value: The new position, -1 if it would be negative or overflow
+ * Function: Moves the position the next read or write starts at. It may
+ *           go past the end; a write there leaves a zeroed hole
+ */
+int32_t fs_file_lseek(FILE *file, int32_t offset, int32_t whence){
+    int32_t base;
+    switch(whence){
+      case SEEK_SET:
+        base = 0;
+        break;
+      case SEEK_CUR:
+        base = file->pos;
+        break;
+      case SEEK_END:
+        base = (int32_t)inode_size(file->inode);
+        break;
+      default:
+        return -1;
+    }
+    if(offset < 0 ? (uint32_t)-offset > (uint32_t)base
+                  : (uint32_t)offset > (uint32_t)0x7FFFFFFF - base)
+      return -1;
+    file->pos = base + offset;
+    return file->pos;
+}
+
+/* Function: fs_file_pread;
+ * Inputs: buf - the buffer we want to copy the file data to
+ *         length - the number of bytes we want to read
+ *         offset - where in the file to read from
+ * Return Value: The number of bytes read
+ * Function: Reads at `offset' without moving the position. read_data
+ *           finds the first block from the offset directly, so this costs
+ *           the same anywhere in the file
+ */
+int32_t fs_file_pread(int8_t* buf, uint32_t length, uint32_t offset, FILE *file){
+    return read_data(file->inode, offset, buf, length);
+}
+
 
 // ======== Directory operation functions ========
 /* Function: fs_dir_open;
@@ -118,12 +333,14 @@ int fs_dir_read(int8_t* buf, uint32_t length, FILE *file){
 }
 
 /* Function: fs_dir_write;
- * Inputs: buf - the buffer we want to write the file data to
- *         length - the number of bytes we want to write
- * Return Value: -1
- * Function: Nothing
+ * Inputs: buf - the name of the new file
+ *         length - the length of the name
+ * Return Value: 0 if the file was created, -1 if failed
+ * Function: Creates an empty regular file named `buf'
  */
-int fs_dir_write(const int8_t* buf, uint32_t length, FILE *file){ return -1; }
+int fs_dir_write(const int8_t* buf, uint32_t length, FILE *file){
+    return fs_create(buf, length);
+}
 
 /* Function: fs_dir_open;
  * Inputs: filename - the file name we want to open
@@ -140,9 +357,38 @@ int fs_dir_close(FILE *file){
  * Inputs: fname - the name of the file
  *         dentry - the dentry variable we want to copy data to
  * Return Value: -1 if failed, 0 if success
- * Function: Copies the data to the dentry variable
+ * Function: Looks the name up in the hash index built by fs_init and copies
+ *           the data to the dentry variable; falls back to the linear scan
+ *           if the index has not been built
  */
 int32_t read_dentry_by_name(const int8_t* fname, dentry_t* dentry){
+    uint32_t slot;
+    if (!dentry_hash_ready) {
+        return read_dentry_by_name_linear(fname, dentry);
+    }
+    if (!fn_length(fname)) {
+        return -1;
+    }
+
+    /* probe until we find the name or hit an empty slot */
+    slot = fn_hash(fname) & (DENTRY_HASH_SIZE - 1);
+    while(dentry_hash[slot] != DENTRY_HASH_EMPTY){
+        if(!strncmp((int8_t*)dentries[(int)dentry_hash[slot]].filename, (int8_t*)fname, MAX_NAME_LENGTH)){
+          return read_dentry_by_index(dentry_hash[slot], dentry);
+        }
+        slot = (slot + 1) & (DENTRY_HASH_SIZE - 1);
+    }
+
+    return -1;
+}
+
+/* Function: read_dentry_by_name_linear
+ * Inputs: fname - the name of the file
+ *         dentry - the dentry variable we want to copy data to
+ * Return Value: -1 if failed, 0 if success
+ * Function: Copies the data to the dentry variable by scanning every dentry
+ */
+int32_t read_dentry_by_name_linear(const int8_t* fname, dentry_t* dentry){
     /* loop index */
     int i;
     /* temp name holder */
@@ -197,82 +443,247 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry){
     return 0;
 }
 
+/* Function: inode_size
+ * Inputs: inode_num - the file's inode number
+ * Return Value: The size of the file in bytes, 0 for an invalid inode
+ * Function: Looks up the length of a file without reading it
+ */
+uint32_t inode_size(int32_t inode_num){
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    if(inode_num < 0 || (uint32_t)inode_num >= inode_count)
+      return 0;
+    return inodes[inode_num].file_size;
+}
+
+/* Function: inode_block
+ * Inputs: inode_num - the file's inode number
+ *         index - which of the file's blocks
+ * Return Value: Pointer to the block, NULL if the file has no such block
+ * Function: Gives direct access to a file's data, for mapping it into a
+ *           task (syscall_mmap). Blocks are page aligned
+ */
+uint8_t* inode_block(int32_t inode_num, uint32_t index){
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    if(inode_num < 0 || (uint32_t)inode_num >= inode_count)
+      return NULL;
+    if(index >= (inodes[inode_num].file_size + BLOCK_SIZE - 1) / BLOCK_SIZE)
+      return NULL;
+    return fs_block(inodes[inode_num].data_blocks[index]);
+}
+
 /* Function: read_data
  * Inputs: inode_num - the file's inode number
  *         offset - the number of bytes already read
  *         buf - the buffer we want to copy data to
  *         length - the number of bytes we want to read
  * Return Value: The number of bytes read
- * Function: Copies the data to the buffer
+ * Function: Copies the data to the buffer. Each data block is resolved once,
+ *           and runs of physically adjacent blocks are handed to memcpy as a
+ *           single extent
  */
 int32_t read_data(int32_t inode_num, uint32_t offset, int8_t* buf, uint32_t length){
-    /* for loop index */
-    int i;
-    /* local variables used to find byte data*/
-    int32_t inode_count;
-    int32_t data_block_count;
-    uint32_t cur_data_block;
-    int32_t data_offset;
-    uint32_t cur_byte;
-    int starting_index;
-    int32_t actual_len;
-    int8_t* cur_buf_pos;
-    int32_t num_bytes = 0;
+    /* local variables used to find the extents to copy */
+    uint32_t inode_count;
+    uint32_t file_size;
+    uint32_t block_index;
+    uint32_t block_offset;
+    uint32_t extent_len;
+    uint32_t actual_len;
+    uint32_t num_bytes = 0;
+    inode_t* inode;
 
     /* get the number of inodes */
-    inode_count = (int32_t)(*((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF)));
+    inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
 
     /* checks to see if the inode_num is valid */
-    if(inode_num > inode_count || inode_num < 0)
+    if(inode_num < 0 || (uint32_t)inode_num >= inode_count)
       return 0;
 
-    /* get the number of data_blocks */
-    data_block_count = (int32_t)(*((uint32_t*)(bblock_ptr + 2 * BOOT_ENTRIES_OFF)));
+    inode = &inodes[inode_num];
+    file_size = inode->file_size;
 
     /* checks to see if the entire file has already been read, return 0 if it has */
-    if(offset >= inodes[inode_num].file_size)
+    if(offset >= file_size)
       return 0;
 
-    /* calculates the actual length to be read, truncates the length if it goes over the
-      amount of bytes that have yet to be read */
-    if( (length + offset > inodes[inode_num].file_size) )
-      actual_len = inodes[inode_num].file_size - offset;
-    else
+    /* truncates the length if it goes over the amount of bytes that have yet to be read */
+    actual_len = file_size - offset;
+    if(length < actual_len)
       actual_len = length;
 
-    /* store buf address with a temp variable that will be iterated through */
-    cur_buf_pos = buf;
+    /* calculates the data block and the offset in it to start on */
+    block_index = offset / BLOCK_SIZE;
+    block_offset = offset % BLOCK_SIZE;
+
+    while(num_bytes < actual_len){
+        /* start an extent at the current block, then grow it while the next
+          block of the file is also the next block of the image */
+        uint8_t* first_block = fs_block(inode->data_blocks[block_index]);
+        extent_len = BLOCK_SIZE - block_offset;
+        while(extent_len < actual_len - num_bytes &&
+              fs_block(inode->data_blocks[block_index + 1]) == fs_block(inode->data_blocks[block_index]) + BLOCK_SIZE){
+          block_index++;
+          extent_len += BLOCK_SIZE;
+        }
+        if(extent_len > actual_len - num_bytes)
+          extent_len = actual_len - num_bytes;
 
-    /* calculates the index of which data block number to start on */
-    starting_index = offset / BLOCK_SIZE;
-    /* get the starting data block */
-    cur_data_block = inodes[inode_num].data_blocks[starting_index];
-    /* calculates where in the file to start reading from */
-    data_offset = offset % BLOCK_SIZE;
+        memcpy(buf + num_bytes, first_block + block_offset, extent_len);
 
-    /* get the address of the first byte we want to read */
-    cur_byte = bblock_ptr + inode_count * BLOCK_SIZE + cur_data_block * BLOCK_SIZE + data_offset + BLOCK_SIZE;
+        num_bytes += extent_len;
+        block_index++;
+        block_offset = 0;
+    }
 
-    /* loops through all the bytes to be read and copying them to the buffer */
+    /* return the number of bytes read */
+    return (int32_t)num_bytes;
+}
+
+/* Function: read_data_bytewise
+ * Inputs: same as read_data
+ * Return Value: The number of bytes read
+ * Function: Reference byte-at-a-time copy that read_data replaced; only kept
+ *           so tests.c can compare the two paths
+ */
+int32_t read_data_bytewise(int32_t inode_num, uint32_t offset, int8_t* buf, uint32_t length){
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    uint32_t i;
+    uint32_t actual_len;
+    uint32_t block_index;
+    uint8_t* cur_byte;
+
+    if(inode_num < 0 || (uint32_t)inode_num >= inode_count)
+      return 0;
+    if(offset >= inodes[inode_num].file_size)
+      return 0;
+
+    actual_len = inodes[inode_num].file_size - offset;
+    if(length < actual_len)
+      actual_len = length;
+
+    block_index = offset / BLOCK_SIZE;
+    cur_byte = fs_block(inodes[inode_num].data_blocks[block_index]) + offset % BLOCK_SIZE;
     for(i = 0; i < actual_len; i++){
         /* checks to see if we should switch to another data block */
-        if( !((i + data_offset) % BLOCK_SIZE) && (i + data_offset) ){
-          starting_index++;
-          cur_data_block = inodes[inode_num].data_blocks[starting_index];
-          cur_byte = bblock_ptr + inode_count * BLOCK_SIZE + (cur_data_block) * BLOCK_SIZE + BLOCK_SIZE;
+        if(i && !((offset + i) % BLOCK_SIZE)){
+          block_index++;
+          cur_byte = fs_block(inodes[inode_num].data_blocks[block_index]);
         }
-        /* copy byte data to buffer */
-        *cur_buf_pos = (int8_t)(*((uint32_t*)cur_byte));
-        /* update the buffer to next position to fill */
-        cur_buf_pos++;
-        /* update byte address to the next byte to be read */
-        cur_byte++;
-        /* increment the number of bytes read counter */
-        num_bytes++;
+        buf[i] = (int8_t)*cur_byte++;
     }
+    return (int32_t)actual_len;
+}
 
-    /* return the number of bytes read */
-    return num_bytes;
+/* Function: write_data
+ * Inputs: inode_num - the file's inode number
+ *         offset - where in the file to start writing
+ *         buf - the data to write
+ *         length - the number of bytes to write
+ * Return Value: The number of bytes written, -1 if none could be
+ * Function: Overwrites existing blocks in place and allocates new ones as
+ *           the file grows. Skipped-over ranges read back as zeros. Drops
+ *           any cached program image of the file
+ */
+int32_t write_data(int32_t inode_num, uint32_t offset, const int8_t* buf, uint32_t length){
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    uint32_t num_blocks, keep_blocks;
+    uint32_t block_index, block_offset;
+    uint32_t chunk_len;
+    uint32_t num_bytes = 0;
+    inode_t* inode;
+
+    if(inode_num < 0 || (uint32_t)inode_num >= inode_count || inode_num >= FS_INODE_MAX
+            || !inode_used[inode_num] || offset >= MAX_BLOCK_NUM * BLOCK_SIZE)
+      return -1;
+    if(length > MAX_BLOCK_NUM * BLOCK_SIZE - offset)
+      length = MAX_BLOCK_NUM * BLOCK_SIZE - offset;
+
+    inode = &inodes[inode_num];
+    num_blocks = (inode->file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    /* the last block may hold stale bytes past the end of the file */
+    if(offset > inode->file_size && inode->file_size % BLOCK_SIZE){
+      memset(fs_block(inode->data_blocks[num_blocks - 1]) + inode->file_size % BLOCK_SIZE, 0,
+            BLOCK_SIZE - inode->file_size % BLOCK_SIZE);
+    }
+
+    block_index = offset / BLOCK_SIZE;
+    block_offset = offset % BLOCK_SIZE;
+    while(num_bytes < length){
+        /* blocks up to this one; the ones before the write start zeroed */
+        while(num_blocks <= block_index){
+          int32_t block = block_alloc(num_blocks ? inode->data_blocks[num_blocks - 1] + 1 : block_hint);
+          if(block < 0)
+            goto write_data__done;
+          if(num_blocks < block_index || block_offset)
+            memset(fs_block(block), 0, BLOCK_SIZE);
+          inode->data_blocks[num_blocks++] = block;
+        }
+
+        chunk_len = BLOCK_SIZE - block_offset;
+        if(chunk_len > length - num_bytes)
+          chunk_len = length - num_bytes;
+        memcpy(fs_block(inode->data_blocks[block_index]) + block_offset, buf + num_bytes, chunk_len);
+
+        num_bytes += chunk_len;
+        block_index++;
+        block_offset = 0;
+    }
+
+write_data__done:
+    if(num_bytes && offset + num_bytes > inode->file_size)
+      inode->file_size = offset + num_bytes;
+    /* give back blocks of a hole that could not be completed */
+    keep_blocks = (inode->file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    while(num_blocks > keep_blocks)
+      block_free(inode->data_blocks[--num_blocks]);
+
+    if(!num_bytes)
+      return length ? -1 : 0;
+    exec_cache_invalidate(inode_num);
+    return (int32_t)num_bytes;
+}
+
+/* Function: fs_create
+ * Inputs: fname - the name of the new file, not necessarily terminated
+ *         length - the length of the name
+ * Return Value: 0 if success, -1 if the name is taken or invalid, or the
+ *               directory or the inodes are full
+ * Function: Adds an empty regular file with a free inode to the directory
+ *           and the name index
+ */
+int32_t fs_create(const int8_t* fname, uint32_t length){
+    uint32_t num_dentries = *(uint32_t*)(bblock_ptr);
+    uint32_t inode_count = *((uint32_t*)(bblock_ptr + BBLOCK_COUNT_OFF));
+    int8_t name[MAX_NAME_LENGTH + 1];
+    dentry_t dent;
+    dentry_t* new_dentry;
+    uint32_t i;
+
+    if(!length || length > MAX_NAME_LENGTH || num_dentries >= MAX_FILE_NUM)
+      return -1;
+    memset(name, 0, sizeof(name));
+    strncpy(name, fname, length);
+    if(fn_length(name) != length || !read_dentry_by_name(name, &dent))
+      return -1;
+
+    for(i = 0; i < inode_count && i < FS_INODE_MAX; i++){
+      if(!inode_used[i])
+        break;
+    }
+    if(i == inode_count || i == FS_INODE_MAX)
+      return -1;
+    inode_used[i] = 1;
+    inodes[i].file_size = 0;
+
+    new_dentry = &dentries[num_dentries];
+    memset(new_dentry, 0, sizeof(dentry_t));
+    memcpy(new_dentry->filename, name, length);
+    new_dentry->filetype = FILE_TYPE_REG;
+    new_dentry->inode_num = i;
+    *(uint32_t*)(bblock_ptr) = num_dentries + 1;
+    dentry_hash_insert(num_dentries);
+    return 0;
 }
 
 /* Function: fn_length
@@ -14,6 +14,21 @@
 #define REGULAR_FILE               2
 #define BOOT_ENTRIES_OFF           4
 #define INODE_ENTRIES_OFF          4
+#define BBLOCK_DATA_COUNT_OFF      8
+// Writable layer. Blocks are numbered past the image's own data blocks up
+// to FS_BLOCK_MAX; those extra blocks come from the frame allocator
+// FS_CHUNK_BLOCKS at a time, so neighbouring numbers stay adjacent in memory
+#define FS_BLOCK_MAX            4096
+#define FS_CHUNK_BLOCKS           32
+// Inodes that can be handed to new files
+#define FS_INODE_MAX             256
+// Open-addressed name index; a power of two at least twice MAX_FILE_NUM
+#define DENTRY_HASH_SIZE         128
+#define DENTRY_HASH_EMPTY         -1
+// Where fs_file_lseek counts the offset from
+#define SEEK_SET                   0
+#define SEEK_CUR                   1
+#define SEEK_END                   2
 
 /* data structures are based off of those discussed in lecture 16 */
 
@@ -44,6 +59,8 @@ int fs_file_open(const int8_t* filename, FILE *file);
 int fs_file_read(int8_t* buf, uint32_t length, FILE *file);
 int fs_file_write(const int8_t* buf, uint32_t length, FILE *file);
 int fs_file_close(FILE *file);
+int32_t fs_file_lseek(FILE *file, int32_t offset, int32_t whence);
+int32_t fs_file_pread(int8_t* buf, uint32_t length, uint32_t offset, FILE *file);
 
 int fs_dir_open(const int8_t* filename, FILE *file);
 int fs_dir_read(int8_t* buf, uint32_t length, FILE *file);
@@ -51,8 +68,14 @@ int fs_dir_write(const int8_t* buf, uint32_t length, FILE *file);
 int fs_dir_close(FILE *file);
 
 int32_t read_dentry_by_name(const int8_t* fname, dentry_t* dentry);
+int32_t read_dentry_by_name_linear(const int8_t* fname, dentry_t* dentry);
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
+uint32_t inode_size(int32_t inode_num);
+uint8_t* inode_block(int32_t inode_num, uint32_t index);
 int32_t read_data(int32_t inode_num, uint32_t offset, int8_t* buf, uint32_t length);
+int32_t read_data_bytewise(int32_t inode_num, uint32_t offset, int8_t* buf, uint32_t length);
+int32_t write_data(int32_t inode_num, uint32_t offset, const int8_t* buf, uint32_t length);
+int32_t fs_create(const int8_t* fname, uint32_t length);
 
 uint32_t fn_length(const int8_t* fname);
 
@@ -0,0 +1,189 @@
+#include "frame.h"
+#include "lib.h"
+
+/* Physical frame allocator
+ * One bit per 4 KB frame below FRAME_MEM_END, set while the frame is in use
+ * or not backed by RAM. The bitmap starts out all set; init_frames clears
+ * the bits of every usable region the boot loader reports and then sets
+ * them again for the memory the kernel already occupies. Allocation scans
+ * the bitmap a word at a time from where the last search succeeded.
+ * Frames shared copy-on-write after fork also carry a count of their extra
+ * owners; frame_free only clears the bit once that count is back to zero.
+ */
+
+#define FRAME_WORD_BITS 32
+#define FRAME_WORDS (FRAME_NUM / FRAME_WORD_BITS)
+// Multiboot flag bits for a valid module list and memory map
+#define MBI_FLAG_MODS 3
+#define MBI_FLAG_MMAP 6
+// Memory map entry type of usable RAM
+#define MMAP_TYPE_RAM 1
+
+uint32_t frame_free_count = 0;
+
+static uint32_t frame_bitmap[FRAME_WORDS];
+static uint32_t frame_hint = 0;
+// Owners of each frame beyond the first; see frame_share
+static uint8_t frame_refs[FRAME_NUM];
+
+/* frame_mark
+ *  Descrption: Mark every frame overlapping [start, end) used or free
+ *  Arg:
+ *      start, end: physical byte range; clipped to FRAME_MEM_END
+ *      used: 1 to reserve the frames, 0 to release them
+ *  RETURN: none
+ */
+static void frame_mark(uint32_t start, uint32_t end, uint8_t used) {
+    uint32_t i;
+    if (end > FRAME_MEM_END) {
+        end = FRAME_MEM_END;
+    }
+    for (i = start >> FRAME_SHIFT; (i << FRAME_SHIFT) < end; i ++) {
+        uint32_t bit = 1 << (i % FRAME_WORD_BITS);
+        uint32_t *word = &frame_bitmap[i / FRAME_WORD_BITS];
+        if (used && !(*word & bit)) {
+            *word |= bit;
+            frame_free_count --;
+        } else if (!used && (*word & bit)) {
+            *word &= ~bit;
+            frame_free_count ++;
+        }
+    }
+}
+
+/* init_frames
+ *  Descrption: Build the free frame bitmap from the multiboot memory map,
+ *      falling back to mem_upper if the boot loader gave no map
+ *  Arg:
+ *      mbi: multiboot information passed to entry()
+ *  RETURN: none
+ */
+void init_frames(multiboot_info_t *mbi) {
+    memset(frame_bitmap, 0xFF, sizeof(frame_bitmap));
+    frame_free_count = 0;
+
+    if (mbi->flags & (1 << MBI_FLAG_MMAP)) {
+        memory_map_t *mmap = (memory_map_t *) mbi->mmap_addr;
+        while ((uint32_t) mmap < mbi->mmap_addr + mbi->mmap_length) {
+            if (mmap->type == MMAP_TYPE_RAM && !mmap->base_addr_high
+                    && mmap->base_addr_low < FRAME_MEM_END) {
+                uint32_t end = mmap->base_addr_low + mmap->length_low;
+                if (mmap->length_high || end < mmap->base_addr_low) {
+                    end = FRAME_MEM_END;
+                }
+                // Only whole frames inside the region are usable
+                frame_mark((mmap->base_addr_low + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1),
+                        end & ~(FRAME_SIZE - 1), 0);
+            }
+            mmap = (memory_map_t *) ((uint32_t) mmap + mmap->size + sizeof(mmap->size));
+        }
+    } else {
+        // mem_upper counts KB starting at 1 MB
+        frame_mark(0x100000, 0x100000 + (mbi->mem_upper << 10), 0);
+    }
+
+    frame_mark(0, FRAME_RESERVED_END, 1);
+    if (mbi->flags & (1 << MBI_FLAG_MODS)) {
+        module_t *mod = (module_t *) mbi->mods_addr;
+        uint32_t i;
+        for (i = 0; i < mbi->mods_count; i ++) {
+            frame_mark(mod[i].mod_start, mod[i].mod_end, 1);
+        }
+    }
+}
+
+/* frame_alloc_contig
+ *  Descrption: Allocate `count' physically contiguous frames, aligned to
+ *      `count' frames; kernel stacks rely on the alignment
+ *  Arg:
+ *      count: a power of two no larger than 32
+ *  RETURN: physical (and kernel) address of the first frame, 0 if none
+ */
+uint32_t frame_alloc_contig(uint32_t count) {
+    uint32_t mask = count == FRAME_WORD_BITS ? ~0 : (1 << count) - 1;
+    uint32_t n, w, i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (n = 0; n < FRAME_WORDS; n ++) {
+        w = (frame_hint + n) % FRAME_WORDS;
+        if (frame_bitmap[w] == ~0U) {
+            continue;
+        }
+        for (i = 0; i < FRAME_WORD_BITS; i += count) {
+            if (!(frame_bitmap[w] & (mask << i))) {
+                frame_bitmap[w] |= mask << i;
+                frame_free_count -= count;
+                frame_hint = w;
+                restore_flags(flags);
+                return (w * FRAME_WORD_BITS + i) << FRAME_SHIFT;
+            }
+        }
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* frame_alloc
+ *  Descrption: Allocate a single frame
+ *  Arg: none
+ *  RETURN: physical (and kernel) address of the frame, 0 if memory is full
+ */
+uint32_t frame_alloc(void) {
+    return frame_alloc_contig(1);
+}
+
+/* frame_free_contig
+ *  Descrption: Return frames obtained from frame_alloc_contig
+ *  Arg:
+ *      addr: address of the first frame
+ *      count: number of frames
+ *  RETURN: none
+ */
+void frame_free_contig(uint32_t addr, uint32_t count) {
+    uint32_t flags;
+    cli_and_save(flags);
+    frame_mark(addr, addr + count * FRAME_SIZE, 0);
+    restore_flags(flags);
+}
+
+/* frame_free
+ *  Descrption: Return a frame obtained from frame_alloc
+ *  Arg:
+ *      addr: address of the frame
+ *  RETURN: none
+ */
+void frame_free(uint32_t addr) {
+    uint32_t flags;
+    cli_and_save(flags);
+    if (frame_refs[addr >> FRAME_SHIFT]) {
+        frame_refs[addr >> FRAME_SHIFT]--;
+    } else {
+        frame_mark(addr, addr + FRAME_SIZE, 0);
+    }
+    restore_flags(flags);
+}
+
+/* frame_share
+ *  Descrption: Add an owner to a frame; each owner gives it back with
+ *      frame_free
+ *  Arg:
+ *      addr: address of the frame
+ *  RETURN: none
+ */
+void frame_share(uint32_t addr) {
+    uint32_t flags;
+    cli_and_save(flags);
+    frame_refs[addr >> FRAME_SHIFT]++;
+    restore_flags(flags);
+}
+
+/* frame_shared
+ *  Descrption: Whether a frame has more than one owner
+ *  Arg:
+ *      addr: address of the frame
+ *  RETURN: 1 if other owners hold it, 0 if the caller is the only one
+ */
+int32_t frame_shared(uint32_t addr) {
+    return frame_refs[addr >> FRAME_SHIFT] != 0;
+}
@@ -0,0 +1,29 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include "types.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE 4096
+#define FRAME_SHIFT 12
+// Frames are handed out from physical memory below FRAME_MEM_END, which the
+// kernel maps one to one (see init_page), so the physical address of a frame
+// is also a kernel pointer to it. The limit keeps the direct map below the
+// user page at 128 MB
+#define FRAME_MEM_END 0x8000000
+#define FRAME_NUM (FRAME_MEM_END >> FRAME_SHIFT)
+// Kernel image, boot stack and video memory; never handed out
+#define FRAME_RESERVED_END 0x800000
+
+// Number of frames still available; read by execute and tests.c
+extern uint32_t frame_free_count;
+
+void init_frames(multiboot_info_t *mbi);
+uint32_t frame_alloc(void);
+uint32_t frame_alloc_contig(uint32_t count);
+void frame_free(uint32_t addr);
+void frame_free_contig(uint32_t addr, uint32_t count);
+void frame_share(uint32_t addr);
+int32_t frame_shared(uint32_t addr);
+
+#endif /* ifndef _FRAME_H_ */
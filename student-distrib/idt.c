@@ -5,11 +5,22 @@
 #include "signals.h"
 #include "syscall.h"
 #include "term.h"
+#include "page.h"
+
+#define CPUID_EDX_SEP   (1 << 11)
+
+// Only used by an NMI or debug trap before _sysenter_isr loads the real
+// kernel stack from the TSS
+static uint32_t sysenter_stack[16];
 
 void exception_handler(uint32_t irq_num, uint32_t errorcode) {
     if (irq_num == 14) {    // PF
         uint32_t addr;
         asm volatile ("movl %%cr2, %0;" : "=r" (addr));
+        // First touch of a user page; retry the access
+        if (!task_page_fault(addr, errorcode)) {
+            return;
+        }
         printf(terms, "exception: irq: %u, error: %u, addr: 0x%#x\n", irq_num, errorcode, addr);
     } else {
         printf(terms, "exception: irq: %u, error: %u\n", irq_num, errorcode);
@@ -83,3 +94,35 @@ void idt_init(void){
 	/* temp set up just to check if idt[syscall] can be non null */
 	SET_IDT_ENTRY(idt[SYSCALL_IDX], &_syscall_isr);
 }
+
+/* static void wrmsr(uint32_t msr, uint32_t value);
+ * Inputs: msr - model specific register to write
+ *         value - its new low 32 bits; the high half is cleared
+ * Return Value: none */
+static void wrmsr(uint32_t msr, uint32_t value){
+	asm volatile ("wrmsr" : : "c"(msr), "a"(value), "d"(0));
+}
+
+/* void init_sysenter(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Points sysenter at _sysenter_isr if CPUID reports it. Early
+ * Pentium Pros (family 6, model and stepping below 3) set the CPUID bit
+ * without having the instructions. The stubs in ece391syscall.S make the
+ * same check before using it */
+void init_sysenter(void){
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile ("cpuid"
+			: "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+			: "a"(1)
+	);
+	if (!(edx & CPUID_EDX_SEP)
+			|| (((eax >> 8) & 0xF) == 6 && ((eax >> 4) & 0xF) < 3 && (eax & 0xF) < 3)) {
+		return;
+	}
+	// sysexit derives the user segments from this: USER_CS is KERNEL_CS + 16
+	// and USER_DS is KERNEL_CS + 24, both at privilege 3
+	wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+	wrmsr(MSR_SYSENTER_ESP, (uint32_t) &sysenter_stack[16]);
+	wrmsr(MSR_SYSENTER_EIP, (uint32_t) &_sysenter_isr);
+}
@@ -4,6 +4,18 @@
 #include "types.h"
 
 #define SYSCALL_IDX     0x80
+// Entries in SYSCALL_JMP_TAB (idt_asm.S)
+#define SYSCALL_NUM     21
+// sigreturn rewrites the whole frame, which sysexit cannot hand back
+#define SYSCALL_SIGRETURN 10
+// pread takes a fourth argument in %esi, which sysenter uses for the
+// return address
+#define SYSCALL_PREAD   20
+
+// Model specific registers for sysenter
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
 
 // Interrupt indexes
 #define PIT_INT     0x20
@@ -59,6 +71,9 @@ extern int _hd1_isr(void);
 extern int _hd2_isr(void);
 
 extern int _syscall_isr(void);
+extern int _sysenter_isr(void);
+
+void init_sysenter(void);
 
 #endif /* ASM */
 
@@ -193,6 +193,17 @@ void kb_isr(void) {
                     term_key_handler((key_t) R(KEY_RIGHT));
                 }
                 break;
+
+            case 0x49:      // Page up
+            case 0x51:      // Page down
+                if (pressed) {
+                    key = (key_t) R(keycode == 0x49 ? KEY_PGUP : KEY_PGDN);
+                    if (ctrl) key.modifiers |= MOD_CTRL;
+                    if (shift) key.modifiers |= MOD_SHIFT;
+                    if (alt) key.modifiers |= MOD_ALT;
+                    term_key_handler(key);
+                }
+                break;
         }
         scan_state = 0;
     }
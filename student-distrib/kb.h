@@ -34,6 +34,8 @@ typedef enum {
     KEY_F11,
     KEY_F12,
     KEY_PRTSCR,
+    KEY_PGUP,
+    KEY_PGDN,
 } raw_key_t;
 
 // Type for uniform key handling
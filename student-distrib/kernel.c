@@ -17,6 +17,8 @@
 #include "signals.h"
 #include "scheduling.h"
 #include "tuxctl.h"
+#include "exec_cache.h"
+#include "frame.h"
 
 extern int32_t do_syscall(int32_t a, int32_t b, int32_t c, int32_t d);
 
@@ -99,6 +101,11 @@ void entry(unsigned long magic, unsigned long addr) {
     idt_init();
     /* Init Paging */
     init_page();
+    init_frames(mbi);
+    /* Let memcpy and memset use SSE2 if the CPU has it */
+    init_sse();
+    /* Take syscalls through sysenter as well as int $0x80 */
+    init_sysenter();
     /* Init the PIC */
     i8259_init();
     /* Init the RTC */
@@ -108,11 +115,11 @@ void entry(unsigned long magic, unsigned long addr) {
 	init_kb();
     /* Init the File System */
     fs_init(bblock_addr);
+    init_exec_cache();
     init_term();
 	init_tuxctl();
     init_pit();
 
-	while (1) {
-		asm volatile ("hlt;");
-	}
+	/* The boot context becomes the idle task */
+	sched_idle();
 }
@@ -109,6 +109,201 @@ uint32_t strlen(const int8_t* s) {
     return len;
 }
 
+// CPUID leaf 1 feature bits in edx
+#define CPUID_EDX_FXSR  (1 << 24)
+#define CPUID_EDX_SSE2  (1 << 26)
+#define CR0_MP          (1 << 1)
+#define CR0_EM          (1 << 2)
+#define CR4_OSFXSR      (1 << 9)
+#define CR4_OSXMMEXCPT  (1 << 10)
+#define IS_VIDEO(p)     ((uint32_t) (p) >= VIDEO && (uint32_t) (p) < VIDEO_END)
+
+uint8_t lib_sse2 = 0;
+
+/* void init_sse(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Turns on SSE if CPUID reports SSE2 and FXSR, and lets memcpy
+ * and memset use it. Tasks do not save the XMM registers across switches,
+ * so the kernel routines save the ones they use and put them back */
+void init_sse(void) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid"
+            : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : "a"(1)
+    );
+    if (!(edx & CPUID_EDX_SSE2) || !(edx & CPUID_EDX_FXSR)) {
+        return;
+    }
+    asm volatile ("                 \n\
+            movl    %%cr0, %%eax    \n\
+            andl    %0, %%eax       \n\
+            orl     %1, %%eax       \n\
+            movl    %%eax, %%cr0    \n\
+            movl    %%cr4, %%eax    \n\
+            orl     %2, %%eax       \n\
+            movl    %%eax, %%cr4    \n\
+            "
+            :
+            : "i"(~CR0_EM), "i"(CR0_MP), "i"(CR4_OSFXSR | CR4_OSXMMEXCPT)
+            : "eax"
+    );
+    lib_sse2 = 1;
+}
+
+/* void* memcpy_sse2(void* dest, const void* src, uint32_t n);
+ * Inputs: same as memcpy; n is at least SSE_COPY_MIN
+ * Return Value: pointer to dest
+ * Function: Aligns dest to 16 bytes, then moves 64 bytes per iteration
+ * through xmm0-xmm3. Large copies and copies to video memory use
+ * non-temporal stores so they do not evict the cache */
+static void* memcpy_sse2(void* dest, const void* src, uint32_t n) {
+    uint8_t save[64 + 15];
+    uint8_t* xmm_save = (uint8_t*) (((uint32_t) save + 15) & ~15);
+    uint32_t head = -(uint32_t) dest & 15;
+    uint32_t blocks;
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    while (head--) {
+        *d++ = *s++;
+        n--;
+    }
+    blocks = n / 64;
+    asm volatile ("                         \n\
+            movdqa  %%xmm0, (%0)            \n\
+            movdqa  %%xmm1, 16(%0)          \n\
+            movdqa  %%xmm2, 32(%0)          \n\
+            movdqa  %%xmm3, 48(%0)          \n\
+            "
+            :
+            : "r"(xmm_save)
+            : "memory"
+    );
+    if (n >= SSE_NT_MIN || IS_VIDEO(dest)) {
+        asm volatile ("                     \n\
+                1:                          \n\
+                movdqu  (%1), %%xmm0        \n\
+                movdqu  16(%1), %%xmm1      \n\
+                movdqu  32(%1), %%xmm2      \n\
+                movdqu  48(%1), %%xmm3      \n\
+                movntdq %%xmm0, (%0)        \n\
+                movntdq %%xmm1, 16(%0)      \n\
+                movntdq %%xmm2, 32(%0)      \n\
+                movntdq %%xmm3, 48(%0)      \n\
+                addl    $64, %1             \n\
+                addl    $64, %0             \n\
+                decl    %2                  \n\
+                jnz     1b                  \n\
+                sfence                      \n\
+                "
+                : "+r"(d), "+r"(s), "+r"(blocks)
+                :
+                : "memory", "cc"
+        );
+    } else {
+        asm volatile ("                     \n\
+                1:                          \n\
+                movdqu  (%1), %%xmm0        \n\
+                movdqu  16(%1), %%xmm1      \n\
+                movdqu  32(%1), %%xmm2      \n\
+                movdqu  48(%1), %%xmm3      \n\
+                movdqa  %%xmm0, (%0)        \n\
+                movdqa  %%xmm1, 16(%0)      \n\
+                movdqa  %%xmm2, 32(%0)      \n\
+                movdqa  %%xmm3, 48(%0)      \n\
+                addl    $64, %1             \n\
+                addl    $64, %0             \n\
+                decl    %2                  \n\
+                jnz     1b                  \n\
+                "
+                : "+r"(d), "+r"(s), "+r"(blocks)
+                :
+                : "memory", "cc"
+        );
+    }
+    asm volatile ("                         \n\
+            movdqa  (%0), %%xmm0            \n\
+            movdqa  16(%0), %%xmm1          \n\
+            movdqa  32(%0), %%xmm2          \n\
+            movdqa  48(%0), %%xmm3          \n\
+            "
+            :
+            : "r"(xmm_save)
+            : "memory"
+    );
+    for (n %= 64; n; n--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+/* void* memset_sse2(void* s, int32_t c, uint32_t n);
+ * Inputs: same as memset; n is at least SSE_COPY_MIN
+ * Return Value: pointer to s
+ * Function: memset counterpart of memcpy_sse2, storing xmm0 */
+static void* memset_sse2(void* s, int32_t c, uint32_t n) {
+    uint8_t save[16 + 15], fill[16 + 15];
+    uint8_t* xmm_save = (uint8_t*) (((uint32_t) save + 15) & ~15);
+    uint32_t* pattern = (uint32_t*) (((uint32_t) fill + 15) & ~15);
+    uint32_t head = -(uint32_t) s & 15;
+    uint32_t blocks;
+    uint8_t* d = s;
+
+    c &= 0xFF;
+    pattern[0] = pattern[1] = pattern[2] = pattern[3] = c << 24 | c << 16 | c << 8 | c;
+    while (head--) {
+        *d++ = c;
+        n--;
+    }
+    blocks = n / 64;
+    asm volatile ("                         \n\
+            movdqa  %%xmm0, (%0)            \n\
+            movdqa  (%1), %%xmm0            \n\
+            "
+            :
+            : "r"(xmm_save), "r"(pattern)
+            : "memory"
+    );
+    if (n >= SSE_NT_MIN || IS_VIDEO(s)) {
+        asm volatile ("                     \n\
+                1:                          \n\
+                movntdq %%xmm0, (%0)        \n\
+                movntdq %%xmm0, 16(%0)      \n\
+                movntdq %%xmm0, 32(%0)      \n\
+                movntdq %%xmm0, 48(%0)      \n\
+                addl    $64, %0             \n\
+                decl    %1                  \n\
+                jnz     1b                  \n\
+                sfence                      \n\
+                "
+                : "+r"(d), "+r"(blocks)
+                :
+                : "memory", "cc"
+        );
+    } else {
+        asm volatile ("                     \n\
+                1:                          \n\
+                movdqa  %%xmm0, (%0)        \n\
+                movdqa  %%xmm0, 16(%0)      \n\
+                movdqa  %%xmm0, 32(%0)      \n\
+                movdqa  %%xmm0, 48(%0)      \n\
+                addl    $64, %0             \n\
+                decl    %1                  \n\
+                jnz     1b                  \n\
+                "
+                : "+r"(d), "+r"(blocks)
+                :
+                : "memory", "cc"
+        );
+    }
+    asm volatile ("movdqa (%0), %%xmm0" : : "r"(xmm_save) : "memory");
+    for (n %= 64; n; n--) {
+        *d++ = c;
+    }
+    return s;
+}
+
 /* void* memset(void* s, int32_t c, uint32_t n);
  * Inputs:    void* s = pointer to memory
  *          int32_t c = value to set memory to
@@ -116,6 +311,9 @@ uint32_t strlen(const int8_t* s) {
  * Return Value: new string
  * Function: set n consecutive bytes of pointer s to value c */
 void* memset(void* s, int32_t c, uint32_t n) {
+    if (lib_sse2 && n >= SSE_COPY_MIN) {
+        return memset_sse2(s, c, n);
+    }
     c &= 0xFF;
     asm volatile ("                 \n\
             .memset_top:            \n\
@@ -199,6 +397,9 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
  * Return Value: pointer to dest
  * Function: copy n bytes of src to dest */
 void* memcpy(void* dest, const void* src, uint32_t n) {
+    if (lib_sse2 && n >= SSE_COPY_MIN) {
+        return memcpy_sse2(dest, src, n);
+    }
     asm volatile ("                 \n\
             .memcpy_top:            \n\
             testl   %%ecx, %%ecx    \n\
@@ -245,20 +446,30 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
  * Return Value: pointer to dest
  * Function: move n bytes of src to dest */
 void* memmove(void* dest, const void* src, uint32_t n) {
+    /* Copying forwards is safe unless dest overlaps the end of src */
+    if ((uint32_t) dest <= (uint32_t) src || (uint32_t) dest >= (uint32_t) src + n) {
+        return memcpy(dest, src, n);
+    }
+    /* Otherwise copy backwards: the odd bytes at the top, then dwords */
+    uint32_t d0, d1, d2;
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
-            cld                                 \n\
-            cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
             leal    -1(%%esi, %%ecx), %%esi     \n\
             leal    -1(%%edi, %%ecx), %%edi     \n\
+            movl    %%ecx, %%edx                \n\
+            andl    $0x3, %%ecx                 \n\
+            shrl    $2, %%edx                   \n\
             std                                 \n\
-            .memmove_go:                        \n\
             rep     movsb                       \n\
+            subl    $3, %%esi                   \n\
+            subl    $3, %%edi                   \n\
+            movl    %%edx, %%ecx                \n\
+            rep     movsl                       \n\
+            cld                                 \n\
             "
-            :
-            : "D"(dest), "S"(src), "c"(n)
+            : "=&D"(d0), "=&S"(d1), "=&c"(d2)
+            : "0"(dest), "1"(src), "2"(n)
             : "edx", "memory", "cc"
     );
     return dest;
@@ -21,6 +21,17 @@ int isalpha(uint8_t ch);
 int isnum(uint8_t ch);
 int isalnum(uint8_t ch);
 
+// memcpy and memset switch to SSE2 from this many bytes
+#define SSE_COPY_MIN    256
+// Copies at least this big bypass the cache with non-temporal stores, as
+// do copies into video memory
+#define SSE_NT_MIN      0x40000
+#define VIDEO_END       0xC0000
+
+// Set by init_sse once SSE2 can be used; tests.c clears it to compare
+extern uint8_t lib_sse2;
+void init_sse(void);
+
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
@@ -37,6 +48,13 @@ void test_interrupts();
 int test_interrupt_freq(int mode, int freq);
 int test_rtc_freq(int mode);
 
+/* Low 32 bits of the time stamp counter; enough for timing short intervals */
+static inline uint32_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -1,11 +1,15 @@
 #include "page.h"
 #include "lib.h"
 #include "x86_desc.h"
+#include "frame.h"
 
 /* global arrays for the page directory and page table */
 PDE_t __attribute__((aligned (4096))) page_directory[MAX_ENTRIES];
 PTE_t __attribute__((aligned (4096))) vidmem_page_table[MAX_ENTRIES];
-PTE_t __attribute__((aligned (4096))) user_vidmem_page_table[MAX_ENTRIES];
+PTE_t __attribute__((aligned (4096))) user_vidmem_page_tables[USER_VIDMEM_TABLES][MAX_ENTRIES];
+
+/* The page directory currently in cr3 */
+static PDE_t *loaded_page_dir = page_directory;
 
 void init_page(void){
     /* for loop indices */
@@ -51,6 +55,10 @@ void init_page(void){
         vidmem_page_table[i].present = 0x1;
         vidmem_page_table[i].user_super = 0x1;
       }
+      else if(i >= VGA_SCROLL_BEG && i < VGA_SCROLL_END){
+        vidmem_page_table[i].present = 0x1;
+        vidmem_page_table[i].user_super = 0x0;
+      }
       else{
         vidmem_page_table[i].present = 0x0;
         vidmem_page_table[i].user_super = 0x0;
@@ -66,26 +74,30 @@ void init_page(void){
       vidmem_page_table[i].page_addr = i;
     }
 
-    for(i = 0; i < MAX_ENTRIES; i++){
-      /* if the current mapping is to the Video memory
-      * then mark present, else mark it unpresent */
-      user_vidmem_page_table[i].read_write = 0x1;
-      user_vidmem_page_table[i].pwt = 0x0;
-      user_vidmem_page_table[i].pcd = 0x0;
-      user_vidmem_page_table[i].accessed = 0x0;
-      user_vidmem_page_table[i].dirty = 0x0;
-      user_vidmem_page_table[i].pat = 0x0;
-      user_vidmem_page_table[i].global = 0x0;
-      user_vidmem_page_table[i].available = 0x0;
-      user_vidmem_page_table[i].page_addr = i;
-      if(i == 0){
-        user_vidmem_page_table[i].present = 0x1;
-        user_vidmem_page_table[i].user_super = 0x1;
-        user_vidmem_page_table[i].page_addr = VID_MEM_ADDR;
-      }
-      else{
-        user_vidmem_page_table[i].present = 0x0;
-        user_vidmem_page_table[i].user_super = 0x0;
+    for(j = 0; j < USER_VIDMEM_TABLES; j++){
+      PTE_t *user_vidmem_page_table = user_vidmem_page_tables[j];
+      for(i = 0; i < MAX_ENTRIES; i++){
+        /* if the current mapping is to the Video memory
+        * then mark present, else mark it unpresent */
+        user_vidmem_page_table[i].read_write = 0x1;
+        user_vidmem_page_table[i].pwt = 0x0;
+        user_vidmem_page_table[i].pcd = 0x0;
+        user_vidmem_page_table[i].accessed = 0x0;
+        user_vidmem_page_table[i].dirty = 0x0;
+        user_vidmem_page_table[i].pat = 0x0;
+        user_vidmem_page_table[i].global = 0x0;
+        user_vidmem_page_table[i].available = 0x0;
+        user_vidmem_page_table[i].page_addr = i;
+        if(i == 0){
+          /* each terminal keeps its own VGA page whether on screen or not */
+          user_vidmem_page_table[i].present = 0x1;
+          user_vidmem_page_table[i].user_super = 0x1;
+          user_vidmem_page_table[i].page_addr = BACKGROUND_1 + j;
+        }
+        else{
+          user_vidmem_page_table[i].present = 0x0;
+          user_vidmem_page_table[i].user_super = 0x0;
+        }
       }
     }
 
@@ -106,20 +118,14 @@ void init_page(void){
       page_directory[j].page_PDE.page_addr = 0x0;
     }
 
-    // Reserve a user page table entry so we can set it directly later
-    page_directory[USER_PAGE_INDEX].page_PDE.present = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.read_write = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.user_super = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.pwt = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.pcd = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.accessed = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.dirty = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.page_size = 0x1;
-    page_directory[USER_PAGE_INDEX].page_PDE.global = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.available = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.pat = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.reserved = 0x0;
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = USER_PAGE_INDEX;
+    // Map the memory frames are handed out from; supervisor only
+    for(j = DIRECT_MAP_BEG_INDEX; j < DIRECT_MAP_END_INDEX; j++){
+      page_directory[j].page_PDE.present = 0x1;
+      page_directory[j].page_PDE.global = 0x1;
+      page_directory[j].page_PDE.page_addr = j;
+    }
+
+    // The user page is a page table owned by each task; see page_dir_setup
 
     page_directory[USER_VIDMEM_INDEX].table_PDE.present = 0x1;
     page_directory[USER_VIDMEM_INDEX].table_PDE.read_write = 0x1;
@@ -131,17 +137,20 @@ void init_page(void){
     page_directory[USER_VIDMEM_INDEX].table_PDE.global = 0x0;
     page_directory[USER_VIDMEM_INDEX].table_PDE.available = 0x0;
     page_directory[USER_VIDMEM_INDEX].table_PDE.reserved = 0x0;
-    page_directory[USER_VIDMEM_INDEX].table_PDE.table_addr = (uint32_t)user_vidmem_page_table >> ADDRESS_SHIFT;
+    page_directory[USER_VIDMEM_INDEX].table_PDE.table_addr = (uint32_t)user_vidmem_page_tables[0] >> ADDRESS_SHIFT;
 
-    /* Enable paging and 4MB pages */
+    /* Enable paging, 4MB pages and global pages; the kernel pages are
+    * global, so they survive the cr3 load of a context switch.
+    * Write protect makes kernel writes to copy-on-write user pages fault
+    * just like user writes do */
     asm volatile(
       " movl %0, %%eax; "
       " movl %%eax, %%cr3; "
       " movl %%cr4, %%eax; "
-      " orl $0x00000010, %%eax; "
+      " orl $0x00000090, %%eax; "
       " movl %%eax, %%cr4; "
       " movl %%cr0, %%eax; "
-      " orl $0x80000001, %%eax; "
+      " orl $0x80010001, %%eax; "
       " movl %%eax, %%cr0; "
       :
       : "r"(page_directory)
@@ -149,3 +158,272 @@ void init_page(void){
     );
 
 }
+
+/* page_dir_setup
+ *  Descrption: Builds the page directory of a new task as a copy of the
+ *      kernel's, with an empty page table for the user page and the user
+ *      video page pointing at its terminal's table. User pages get frames
+ *      as they are touched; see task_page_fault / page_user_alloc
+ *  Arg:
+ *      term_ind: the terminal the task runs on
+ *  RETURN: the task's page directory, NULL if out of memory
+ */
+PDE_t *page_dir_setup(uint8_t term_ind){
+    PDE_t *dir = (PDE_t *) frame_alloc();
+    PTE_t *table = (PTE_t *) frame_alloc();
+    if (!dir || !table) {
+        if (dir) {
+            frame_free((uint32_t) dir);
+        }
+        if (table) {
+            frame_free((uint32_t) table);
+        }
+        return NULL;
+    }
+    // A reused frame must not satisfy page_dir_load's check
+    if (dir == loaded_page_dir) {
+        loaded_page_dir = NULL;
+    }
+    memcpy(dir, page_directory, sizeof(page_directory));
+    memset(table, 0, PAGE_SIZE);
+
+    dir[USER_PAGE_INDEX].table_PDE.present = 0x1;
+    dir[USER_PAGE_INDEX].table_PDE.read_write = 0x1;
+    dir[USER_PAGE_INDEX].table_PDE.user_super = 0x1;
+    dir[USER_PAGE_INDEX].table_PDE.page_size = 0x0;
+    dir[USER_PAGE_INDEX].table_PDE.global = 0x0;
+    dir[USER_PAGE_INDEX].table_PDE.table_addr = (uint32_t)table >> ADDRESS_SHIFT;
+    dir[USER_VIDMEM_INDEX].table_PDE.table_addr = (uint32_t)user_vidmem_page_tables[term_ind] >> ADDRESS_SHIFT;
+    return dir;
+}
+
+/* page_dir_fork
+ *  Descrption: Builds the page directory of a forked task. The child
+ *      maps the same frames as `src'; writable pages become read-only
+ *      copy-on-write pages in both, and page_user_cow splits them on the
+ *      first write
+ *  Arg:
+ *      src: page directory of the forking task
+ *      term_ind: the terminal the child runs on
+ *  RETURN: the child's page directory, NULL if out of memory
+ */
+PDE_t *page_dir_fork(PDE_t *src, uint8_t term_ind){
+    PDE_t *dir = page_dir_setup(term_ind);
+    PTE_t *src_table = (PTE_t *) (src[USER_PAGE_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    PTE_t *table;
+    int i;
+    if (!dir) {
+        return NULL;
+    }
+    table = (PTE_t *) (dir[USER_PAGE_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    for(i = 0; i < MAX_ENTRIES; i++){
+      if(src_table[i].present){
+        if(src_table[i].read_write){
+          src_table[i].read_write = 0x0;
+          src_table[i].available |= PTE_AVAIL_COW;
+        }
+        table[i] = src_table[i];
+        frame_share(src_table[i].page_addr << ADDRESS_SHIFT);
+      }
+    }
+    // Mapped files are read-only and not refcounted; copy the entries as is
+    if(src[USER_MMAP_INDEX].table_PDE.present){
+      src_table = (PTE_t *) (src[USER_MMAP_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+      if(!(table = (PTE_t *) frame_alloc())){
+        page_dir_free(dir);
+        return NULL;
+      }
+      memcpy(table, src_table, PAGE_SIZE);
+      dir[USER_MMAP_INDEX] = src[USER_MMAP_INDEX];
+      dir[USER_MMAP_INDEX].table_PDE.table_addr = (uint32_t)table >> ADDRESS_SHIFT;
+    }
+    // The parent's writable entries may be cached; reload cr3 to drop them
+    if (src == loaded_page_dir) {
+      asm volatile(
+        " movl %0, %%cr3; "
+        :
+        : "r"(src)
+        : "memory"
+      );
+    }
+    return dir;
+}
+
+/* page_dir_free
+ *  Descrption: Releases a task's page directory, its user page table and
+ *      every frame mapped through it. The blocks of mapped files stay with
+ *      the file system; only their page table goes. `dir' must not be loaded
+ *  Arg:
+ *      dir: directory returned by page_dir_setup
+ *  RETURN: none
+ */
+void page_dir_free(PDE_t *dir){
+    PTE_t *table = (PTE_t *) (dir[USER_PAGE_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    int i;
+    for(i = 0; i < MAX_ENTRIES; i++){
+      if(table[i].present){
+        frame_free(table[i].page_addr << ADDRESS_SHIFT);
+      }
+    }
+    frame_free((uint32_t) table);
+    if(dir[USER_MMAP_INDEX].table_PDE.present){
+      frame_free(dir[USER_MMAP_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    }
+    frame_free((uint32_t) dir);
+}
+
+/* page_user_alloc
+ *  Descrption: Maps a fresh frame at the faulting page of the user page in
+ *      the loaded address space. The caller fills it; see task_page_fault
+ *  Arg:
+ *      addr: faulting address from cr2
+ *      errorcode: error code pushed by the CPU
+ *  RETURN: kernel pointer to the new frame, NULL if the fault is a real
+ *      error or memory is full
+ */
+uint8_t *page_user_alloc(uint32_t addr, uint32_t errorcode){
+    PTE_t *table;
+    PTE_t *pte;
+    uint32_t frame;
+
+    // Protection violations and addresses outside the user page are errors
+    if ((errorcode & PF_ERR_PRESENT) || addr < TASK_VIRT_PAGE_BEG || addr >= TASK_VIRT_PAGE_END
+            || loaded_page_dir == page_directory) {
+        return NULL;
+    }
+    table = (PTE_t *) (loaded_page_dir[USER_PAGE_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    pte = &table[PAGE_TABLE_INDEX(addr)];
+    if (pte->present || !(frame = frame_alloc())) {
+        return NULL;
+    }
+    pte->page_addr = frame >> ADDRESS_SHIFT;
+    pte->read_write = 0x1;
+    pte->user_super = 0x1;
+    pte->present = 0x1;
+    return (uint8_t *) frame;
+}
+
+/* page_user_cow
+ *  Descrption: Resolves a write to a copy-on-write page of the loaded
+ *      address space. The last owner of a frame takes it back writable;
+ *      otherwise the page gets a private copy
+ *  Arg:
+ *      addr: faulting address from cr2
+ *      errorcode: error code pushed by the CPU
+ *  RETURN: 1 if the page was copied, 0 if it was made writable in place,
+ *      -1 if the fault is a real error or memory is full
+ */
+int32_t page_user_cow(uint32_t addr, uint32_t errorcode){
+    PTE_t *table;
+    PTE_t *pte;
+    uint32_t old, frame;
+
+    if ((errorcode & (PF_ERR_PRESENT | PF_ERR_WRITE)) != (PF_ERR_PRESENT | PF_ERR_WRITE)
+            || addr < TASK_VIRT_PAGE_BEG || addr >= TASK_VIRT_PAGE_END
+            || loaded_page_dir == page_directory) {
+        return -1;
+    }
+    table = (PTE_t *) (loaded_page_dir[USER_PAGE_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    pte = &table[PAGE_TABLE_INDEX(addr)];
+    if (!pte->present || !(pte->available & PTE_AVAIL_COW)) {
+        return -1;
+    }
+    old = pte->page_addr << ADDRESS_SHIFT;
+    if (!frame_shared(old)) {
+        frame = 0;
+    } else if ((frame = frame_alloc())) {
+        memcpy((void *) frame, (void *) old, PAGE_SIZE);
+        frame_free(old);
+        pte->page_addr = frame >> ADDRESS_SHIFT;
+    } else {
+        return -1;
+    }
+    pte->available &= ~PTE_AVAIL_COW;
+    pte->read_write = 0x1;
+    asm volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+    return frame != 0;
+}
+
+/* page_mmap_reserve
+ *  Descrption: Finds the first run of `count' unmapped pages in the mmap
+ *      area of the loaded address space, giving the task its mmap page
+ *      table on first use. The pages stay unmapped until page_mmap_block
+ *  Arg:
+ *      count: number of pages wanted
+ *  RETURN: user address of the first page, 0 if there is no room or
+ *      memory is full
+ */
+uint32_t page_mmap_reserve(uint32_t count){
+    PTE_t *table;
+    uint32_t i, run = 0;
+    uint32_t frame;
+
+    if (!count || count > MAX_ENTRIES || loaded_page_dir == page_directory) {
+        return 0;
+    }
+    if (!loaded_page_dir[USER_MMAP_INDEX].table_PDE.present) {
+        if (!(frame = frame_alloc())) {
+            return 0;
+        }
+        memset((void *) frame, 0, PAGE_SIZE);
+        loaded_page_dir[USER_MMAP_INDEX].table_PDE.read_write = 0x1;
+        loaded_page_dir[USER_MMAP_INDEX].table_PDE.user_super = 0x1;
+        loaded_page_dir[USER_MMAP_INDEX].table_PDE.page_size = 0x0;
+        loaded_page_dir[USER_MMAP_INDEX].table_PDE.global = 0x0;
+        loaded_page_dir[USER_MMAP_INDEX].table_PDE.table_addr = frame >> ADDRESS_SHIFT;
+        loaded_page_dir[USER_MMAP_INDEX].table_PDE.present = 0x1;
+    }
+    table = (PTE_t *) (loaded_page_dir[USER_MMAP_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    for (i = 0; i < MAX_ENTRIES; i++) {
+        run = table[i].present ? 0 : run + 1;
+        if (run == count) {
+            return TASK_MMAP_BEG + (i + 1 - count) * PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+/* page_mmap_block
+ *  Descrption: Maps a file system block read-only at `addr'. Blocks are
+ *      page aligned and reached one to one, so the PTE points straight at
+ *      the block and reads need no copy. Writes fault like any other
+ *      read-only page. The entry was not present, so no TLB flush is needed
+ *  Arg:
+ *      addr: a page returned by page_mmap_reserve
+ *      block: kernel pointer to the block
+ *  RETURN: none
+ */
+void page_mmap_block(uint32_t addr, uint8_t *block){
+    PTE_t *table = (PTE_t *) (loaded_page_dir[USER_MMAP_INDEX].table_PDE.table_addr << ADDRESS_SHIFT);
+    PTE_t *pte = &table[PAGE_TABLE_INDEX(addr)];
+
+    pte->page_addr = (uint32_t) block >> ADDRESS_SHIFT;
+    pte->read_write = 0x0;
+    pte->user_super = 0x1;
+    pte->available = PTE_AVAIL_FILE;
+    pte->present = 0x1;
+}
+
+/* page_dir_load
+ *  Descrption: Switches to the address space `dir'. Loading cr3 flushes
+ *      every non-global TLB entry, so it is skipped when `dir' is already
+ *      loaded, e.g. when a task resumes after the idle task borrowed its
+ *      address space
+ *  Arg:
+ *      dir: the page directory to load
+ *  RETURN: 1 if cr3 was loaded, 0 if it was skipped
+ */
+int32_t page_dir_load(PDE_t *dir){
+    if (dir == loaded_page_dir) {
+        return 0;
+    }
+    loaded_page_dir = dir;
+    asm volatile(
+      " movl %0, %%cr3; "
+      :
+      : "r"(dir)
+      : "memory"
+    );
+    return 1;
+}
+
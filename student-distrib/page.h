@@ -11,13 +11,21 @@
 #define BACKGROUND_1      0xB9
 #define BACKGROUND_2      0xBA
 #define BACKGROUND_3      0xBB
+// Rest of VGA text memory; kernel only, used for hardware scrolling (term.c)
+#define VGA_SCROLL_BEG    0xBC
+#define VGA_SCROLL_END    0xC0
 #define TASK_VIRT_PAGE_BEG 0x8000000
 #define TASK_VIRT_PAGE_END 0x8400000
 #define TASK_VIDMEM_START  0x8800000
+// Files mapped by syscall_mmap go in the 4 MB between the user page and the
+// user video page, through a page table each task gets on its first mmap
+#define TASK_MMAP_BEG      TASK_VIRT_PAGE_END
+#define TASK_MMAP_END      TASK_VIDMEM_START
 // 4 MB = 4 * 1024 * 1024
 #define PAGE_TABLE_ADDR_SHIFT (2 + 10 + 10)
 #define USER_PAGE_INDEX (TASK_VIRT_PAGE_BEG >> PAGE_TABLE_ADDR_SHIFT)
 #define USER_VIDMEM_INDEX (TASK_VIDMEM_START >> PAGE_TABLE_ADDR_SHIFT)
+#define USER_MMAP_INDEX (TASK_MMAP_BEG >> PAGE_TABLE_ADDR_SHIFT)
 
 /* Structure for a page table entry */
 typedef struct __attribute__ ((packed)) PTE_t{
@@ -67,11 +75,46 @@ typedef union PDE_t {
     } __attribute__ ((packed)) table_PDE;
 } PDE_t;
 
+// One user video page table per terminal; entry 0 maps that terminal's own
+// VGA page for good, whether or not it is on display
+#define USER_VIDMEM_TABLES 3
+// Kernel 4 MB pages from 8 MB up to the user page map physical memory one
+// to one, so frames from frame.c can be reached directly
+#define DIRECT_MAP_BEG_INDEX 2
+#define DIRECT_MAP_END_INDEX USER_PAGE_INDEX
+// Page fault error code bits
+#define PF_ERR_PRESENT 0x1
+#define PF_ERR_WRITE   0x2
+#define PF_ERR_USER    0x4
+// Set in PTE_t.available of a read-only page shared copy-on-write
+#define PTE_AVAIL_COW  0x1
+// Set in PTE_t.available of a read-only page of a file system block; the
+// block belongs to file_sys.c, so it is never freed or refcounted here
+#define PTE_AVAIL_FILE 0x2
+// Index of the 4 KB page of `addr' inside its page table
+#define PAGE_TABLE_INDEX(addr) (((addr) >> ADDRESS_SHIFT) & (MAX_ENTRIES - 1))
+
 /* initializes the page directory and enables paging */
 void init_page(void);
+/* builds the page directory of a new task from the kernel's */
+PDE_t *page_dir_setup(uint8_t term_ind);
+/* builds the copy-on-write page directory of a forked task */
+PDE_t *page_dir_fork(PDE_t *src, uint8_t term_ind);
+/* frees a task's page directory and every user frame mapped in it */
+void page_dir_free(PDE_t *dir);
+/* maps a new frame for a faulting user page; NULL if it cannot be mapped */
+uint8_t *page_user_alloc(uint32_t addr, uint32_t errorcode);
+/* gives a faulting copy-on-write page a private writable frame */
+int32_t page_user_cow(uint32_t addr, uint32_t errorcode);
+/* finds `count' free pages in the loaded task's mmap area */
+uint32_t page_mmap_reserve(uint32_t count);
+/* maps a file system block read-only at `addr' of the mmap area */
+void page_mmap_block(uint32_t addr, uint8_t *block);
+/* switches address spaces, skipping the cr3 load if `dir' is current */
+int32_t page_dir_load(PDE_t *dir);
 
 PDE_t page_directory[MAX_ENTRIES];
 PTE_t vidmem_page_table[MAX_ENTRIES];
-PTE_t user_vidmem_page_table[MAX_ENTRIES];
+PTE_t user_vidmem_page_tables[USER_VIDMEM_TABLES][MAX_ENTRIES];
 
 #endif
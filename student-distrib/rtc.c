@@ -6,6 +6,7 @@
 #include "i8259.h"
 #include "task.h"
 #include "syscall.h"
+#include "scheduling.h"
 
 #define RTC_SYS_START_FREQ 2
 
@@ -34,6 +35,8 @@ static int32_t get_target_count( int32_t sys_int_freq, int32_t target_int_freq){
 }
 
 static FILE *rtc_files[MAX_PROC_NUM] = {NULL};
+// Tasks blocked in rtc_read; woken whenever any virtual RTC ticks
+static wait_queue_t rtc_wait;
 
 file_ops_table_t rtc_file_ops_table = {
     .open = rtc_open,
@@ -321,6 +324,7 @@ int32_t rtc_read(){
 	(void) inb(RTC_DATA_PORT);
 	uint8_t i;
 	int count ;
+	int8_t ticked = 0;
 	for (i = 0; i < MAX_PROC_NUM; i ++) {
 		time_elasped[i] += sys_counter_step;
 		if (time_elasped[i] >= SYS_COUNTER_MAX){
@@ -339,13 +343,19 @@ int32_t rtc_read(){
 				 	count = 32;
 				}
 				set_rtc_count_field(cur_file->inode, count );
+				ticked = 1;
 			}
 		}
 	}
+	if (ticked) {
+		sched_wake_up(&rtc_wait);
+	}
 }
 
 /* rtc_read
  *	Descrption:	a user blocking function intended to wait for the next RTC interrupt.
+ *		The caller sleeps on `rtc_wait' and is off the run queue until rtc_isr
+ *		wakes it.
  *	Args:
  *		buf: (not used) Use NULL in this argument
  *		length: (not used) Use 0 in this argument
@@ -354,11 +364,10 @@ int32_t rtc_read(){
   */
 int32_t rtc_read(int8_t* buf, uint32_t length, FILE *file){
 	int count;
-	sti();
+	cli();
 	while( (count=get_rtc_count(file->inode)) == 0 ){
-		asm volatile ("hlt");
+		sched_sleep_on(&rtc_wait);
 	}
-	cli();
 	if( count >=1 ){
 		count -= 1;
 		set_rtc_count_field(file->inode, count);
@@ -4,11 +4,117 @@
 #include "x86_desc.h"
 #include "term.h"
 
+volatile uint32_t pit_ticks = 0;
+volatile uint32_t pit_interrupts = 0;
+uint8_t pit_nohz = 1;
+uint32_t sched_quantum = SCHED_QUANTUM_DEF;
+sched_stats_t sched_stats;
+
+/* Circular doubly linked list of runnable tasks, linked through the PCBs.
+ * Tasks owning a terminal and forked tasks are on it; a parent waiting in
+ * execute is taken off until its child halts. */
+static PCB_t *run_queue = NULL;
+
+// Count loaded into the PIT for the pending one-shot; 0 while stopped
+static uint16_t pit_armed = 0;
+// Elapsed PIT clocks not yet folded into `pit_ticks'
+static uint32_t pit_clock_rem = 0;
+// Set until every terminal has had its first shell started
+static uint8_t sched_booting = 1;
+// Start of the stack switch in progress; the task switched to finishes
+// the measurement
+static uint32_t switch_tsc;
+static uint8_t switch_pending = 0;
+
+/* uint32_t pit_sync;
+ * Inputs: None
+ * Return Value: PIT clocks that passed since the timer was last armed
+ * Function: Ends the pending one-shot, if any, and advances `pit_ticks' by
+ * the time it covered. Call with interrupts disabled
+ */
+static uint32_t pit_sync(){
+    uint32_t elapsed = 0;
+    uint32_t remaining;
+    uint8_t status;
+
+    if (pit_armed) {
+        outb(PIT_READBACK_CH0, PIT_CMD_REG);
+        status = inb(PIT_DATA0_PORT);
+        remaining = inb(PIT_DATA0_PORT);
+        remaining |= inb(PIT_DATA0_PORT) << 8;
+        // Once expired a mode 0 counter wraps around; trust the OUT pin
+        elapsed = (status & PIT_STATUS_OUT || remaining > pit_armed) ?
+            pit_armed : pit_armed - remaining;
+        pit_armed = 0;
+    }
+
+    pit_clock_rem += elapsed;
+    while (pit_clock_rem >= _33HZ_DIV) {
+        pit_clock_rem -= _33HZ_DIV;
+        pit_ticks++;
+    }
+    return elapsed;
+}
+
+/* void pit_arm;
+ * Inputs: clocks - PIT clocks until the next interrupt; 0 stops the timer
+ * Return Value: None
+ * Function: Reprograms the PIT as a one-shot timer. Call with interrupts
+ * disabled
+ */
+static void pit_arm(uint32_t clocks){
+    pit_sync();
+    if (clocks > PIT_MAX_COUNT) {
+        clocks = PIT_MAX_COUNT;
+    }
+    // Writing the control word alone halts a mode 0 counter
+    outb(PIT_MODE0, PIT_CMD_REG);
+    if (clocks) {
+        outb(clocks & 0xFF, PIT_DATA0_PORT);
+        outb(clocks >> 8, PIT_DATA0_PORT);
+    }
+    pit_armed = clocks;
+}
+
+/* void pit_arm_for;
+ * Inputs: pcb - the task about to run
+ * Return Value: None
+ * Function: Arms the PIT for the next deadline of `pcb': the end of its time
+ * slice if anything else is waiting for the CPU. With no other task to
+ * switch to the timer stays stopped, unless shells still have to be started,
+ * `pit_nohz' is off or the terminal on screen has output left to draw
+ */
+static void pit_arm_for(PCB_t *pcb){
+    if (pcb != SCHED_IDLE_PCB && pcb->on_run_queue && pcb->run_next != pcb) {
+        pit_arm(pcb->slice_left);
+    } else if (sched_booting || !pit_nohz || (pcb == SCHED_IDLE_PCB && run_queue)
+            || term_output_pending()) {
+        pit_arm(_33HZ_DIV);
+    } else {
+        pit_arm(0);
+    }
+}
+
+/* void pit_kick;
+ * Inputs: None
+ * Return Value: None
+ * Function: Restarts a stopped timer if the running task now needs one;
+ * used when `pit_nohz' is turned off
+ */
+void pit_kick(){
+    uint32_t flags;
+    cli_and_save(flags);
+    if (!pit_armed) {
+        pit_arm_for(get_cur_pcb());
+    }
+    restore_flags(flags);
+}
+
 /* void init_pit;
  * Inputs: None
  * Return Value: None
- * Function: Initializes interrupt support for the PIT and sets the
- * timer interval to 30ms
+ * Function: Initializes interrupt support for the PIT and arms the first
+ * 30 ms one-shot, which starts the shells
  */
 void init_pit(){
 
@@ -16,80 +122,280 @@ void init_pit(){
     SET_IDT_ENTRY(idt[PIT_INT], _pit_isr);
     idt[PIT_INT].present = 1;
 
-    // Calculate 30 millisecond timer interrupt
-    int32_t set_30MS = CLOCK_TICK_RATE / _33HZ_DIV;
-    // Set pit mode to a square wave
-    outb(PIT_MODE3, PIT_CMD_REG);
-    // Set low bits
-    outb(set_30MS & 0xFF, PIT_DATA0_PORT);
-    // Set high bits
-    outb(set_30MS >> 8, PIT_DATA0_PORT);
+    pit_arm(_33HZ_DIV);
 
     enable_irq(PIT_IRQNUM);
 }
 
+/* void sched_init_task;
+ * Inputs: pcb - a freshly created task
+ * Return Value: None
+ * Function: Gives a new task the default priority; it is not queued yet
+ */
+void sched_init_task(PCB_t *pcb){
+    pcb->state = TASK_BLOCKED;
+    pcb->priority = SCHED_PRIO_DEF;
+    pcb->on_run_queue = 0;
+    pcb->slice_left = SCHED_PRIO_DEF * sched_quantum;
+    pcb->run_next = pcb->run_prev = NULL;
+    pcb->wait_next = NULL;
+}
+
+/* void sched_enqueue;
+ * Inputs: pcb - the task that became runnable
+ * Return Value: None
+ * Function: Adds a task to the tail of the run queue
+ */
+void sched_enqueue(PCB_t *pcb){
+    uint32_t flags;
+    cli_and_save(flags);
+    if (!pcb->on_run_queue) {
+        if (run_queue) {
+            pcb->run_next = run_queue;
+            pcb->run_prev = run_queue->run_prev;
+            run_queue->run_prev->run_next = pcb;
+            run_queue->run_prev = pcb;
+        } else {
+            pcb->run_next = pcb->run_prev = pcb;
+            run_queue = pcb;
+        }
+        pcb->on_run_queue = 1;
+        pcb->runnable_since = rdtsc();
+        /* A second runnable task means the running one needs a deadline */
+        if (!pit_armed && run_queue->run_next != run_queue) {
+            pit_arm(sched_quantum);
+        }
+    }
+    pcb->state = TASK_RUNNABLE;
+    restore_flags(flags);
+}
+
+/* void sched_dequeue;
+ * Inputs: pcb - the task that blocked or exited
+ * Return Value: None
+ * Function: Takes a task off the run queue so the PIT never picks it
+ */
+void sched_dequeue(PCB_t *pcb){
+    uint32_t flags;
+    cli_and_save(flags);
+    if (pcb->on_run_queue) {
+        if (pcb->run_next == pcb) {
+            run_queue = NULL;
+        } else {
+            pcb->run_prev->run_next = pcb->run_next;
+            pcb->run_next->run_prev = pcb->run_prev;
+            if (run_queue == pcb) {
+                run_queue = pcb->run_next;
+            }
+        }
+        pcb->run_next = pcb->run_prev = NULL;
+        pcb->on_run_queue = 0;
+    }
+    pcb->state = TASK_BLOCKED;
+    restore_flags(flags);
+}
+
+/* void sched_set_quantum;
+ * Inputs: clocks - PIT clocks per priority level
+ * Return Value: None
+ * Function: Changes the base time slice, down to SCHED_QUANTUM_MIN; takes
+ * effect at the next refill
+ */
+void sched_set_quantum(uint32_t clocks){
+    sched_quantum = clocks < SCHED_QUANTUM_MIN ? SCHED_QUANTUM_MIN : clocks;
+}
+
+/* int32_t sched_set_priority;
+ * Inputs: pcb - the task to change
+ *         priority - SCHED_PRIO_MIN to SCHED_PRIO_MAX
+ * Return Value: 0 on success, -1 if the priority is out of range
+ * Function: Sets how many quanta the task runs per time slice
+ */
+int32_t sched_set_priority(PCB_t *pcb, uint8_t priority){
+    if (priority < SCHED_PRIO_MIN || priority > SCHED_PRIO_MAX) {
+        return -1;
+    }
+    pcb->priority = priority;
+    return 0;
+}
+
+/* void sched_switch_to;
+ * Inputs: cur - the task giving up the CPU
+ *         next - the task to run, possibly the idle task
+ * Return Value: None; returns once `cur' is switched back to
+ * Function: Loads the address space and TSS of `next' and swaps kernel
+ * stacks
+ */
+static void sched_switch_to(PCB_t *cur, PCB_t *next){
+    uint32_t now = rdtsc();
+
+    if (next != SCHED_IDLE_PCB) {
+        /* Switch address spaces; the idle task only touches kernel memory,
+         * so it keeps whatever is loaded and a task resuming after idle
+         * skips the cr3 load */
+        sched_stats.cr3_loads += page_dir_load(next->page_dir);
+        tss.esp0 = PCB_KSTACK_BOT(next);
+        tss.ss0 = KERNEL_DS;
+
+        next->slice_left = next->priority * sched_quantum;
+        sched_stats.dispatches++;
+        sched_stats.latency_total += now - next->runnable_since;
+        if (now - next->runnable_since > sched_stats.latency_max) {
+            sched_stats.latency_max = now - next->runnable_since;
+        }
+    }
+    if (cur != SCHED_IDLE_PCB) {
+        cur->runnable_since = now;
+    }
+    sched_stats.switches++;
+    pit_arm_for(next);
+    switch_tsc = rdtsc();
+    switch_pending = 1;
+    sched_switch(&cur->sched_esp, next->sched_esp);
+    /* Running as `cur' again; account the switch that brought us here */
+    if (switch_pending) {
+        switch_pending = 0;
+        now = rdtsc() - switch_tsc;
+        sched_stats.switch_cycles += now;
+        if (now > sched_stats.switch_max) {
+            sched_stats.switch_max = now;
+        }
+    }
+}
+
+/* void sched_sleep_on;
+ * Inputs: wq - the event to wait for
+ * Return Value: None; returns after sched_wake_up(wq) and once the task is
+ * scheduled again
+ * Function: Blocks the calling task on `wq' and gives the CPU to the next
+ * runnable task. Must be called with interrupts disabled, right after the
+ * caller found its condition false, so a wakeup cannot slip in between.
+ * Wakeups may be spurious; callers re-check their condition in a loop
+ */
+void sched_sleep_on(wait_queue_t *wq){
+    PCB_t *cur_proc = get_cur_pcb();
+
+    cur_proc->wait_next = wq->head;
+    wq->head = cur_proc;
+    sched_dequeue(cur_proc);
+
+    sched_switch_to(cur_proc, run_queue ? run_queue : SCHED_IDLE_PCB);
+}
+
+/* void sched_exit;
+ * Inputs: pcb - the running task, already unlinked and freed by halt
+ * Return Value: None; never returns
+ * Function: Gives the CPU away for good. Must be called with interrupts
+ * disabled; the freed kernel stack stays usable until the switch since
+ * nothing can allocate it in between
+ */
+void sched_exit(PCB_t *pcb){
+    sched_dequeue(pcb);
+    sched_switch_to(pcb, run_queue ? run_queue : SCHED_IDLE_PCB);
+    // unreachable; nothing ever switches back to `pcb'
+    while (1) { asm volatile ("hlt;"); }
+}
+
+/* void sched_wake_up;
+ * Inputs: wq - the event that happened
+ * Return Value: None
+ * Function: Puts every task sleeping on `wq' back on the run queue. Safe to
+ * call from interrupt handlers; the tasks run from the next PIT tick on, or
+ * right away if the CPU is idle
+ */
+void sched_wake_up(wait_queue_t *wq){
+    uint32_t flags;
+    PCB_t *pcb, *next;
+    cli_and_save(flags);
+    for (pcb = wq->head; pcb; pcb = next) {
+        next = pcb->wait_next;
+        pcb->wait_next = NULL;
+        sched_enqueue(pcb);
+    }
+    wq->head = NULL;
+    restore_flags(flags);
+}
+
+/* void sched_idle;
+ * Inputs: None
+ * Return Value: None; never returns
+ * Function: Body of the idle task. Halts until an interrupt and hands the
+ * CPU to the run queue as soon as an interrupt handler made a task runnable,
+ * instead of waiting for the next PIT tick
+ */
+void sched_idle(){
+    while (1) {
+        asm volatile ("hlt;");
+        cli();
+        if (run_queue) {
+            sched_switch_to(SCHED_IDLE_PCB, run_queue);
+        }
+        sti();
+    }
+}
+
 /* void pit_isr;
  * Inputs: None
  * Return Value: None
- * Function: Interrupt handler for PIT, schedules processes to run
- * in a round robin fashion
+ * Function: Interrupt handler for the PIT one-shot. Draws some of the output
+ * queued on the terminal on screen and starts a shell on every terminal that
+ * has none, then charges the running task for the time that passed and, once
+ * its time slice is used up, switches to the next task on the run queue.
+ * Blocked tasks are not on the queue; the idle task runs when nothing else
+ * can. Re-arms the timer only if there is a next deadline
  */
 void pit_isr(){
-    static uint8_t cur_proc_ind = 0;
+    uint8_t i;
+    uint32_t elapsed;
+    PCB_t *next_proc;
     /* Send an eoi first as always */
     send_eoi(PIT_IRQNUM);
+    pit_interrupts++;
+    elapsed = pit_sync();
+    term_drain_foreground();
 
-    uint8_t next_pid;
     PCB_t* cur_proc = get_cur_pcb();
 
     // Sanity check
     if(!cur_proc)
         return;
 
-    cur_proc_ind = (cur_proc_ind + 1) % TERM_NUM;
-    if (!terms[cur_proc_ind].cur_pid) {
-        _syscall_execute("shell", cur_proc_ind);
+    for (i = 0; i < TERM_NUM; i++) {
+        if (!terms[i].cur_pid) {
+            if (cur_proc != SCHED_IDLE_PCB) {
+                cur_proc->runnable_since = rdtsc();
+            }
+            pit_arm(_33HZ_DIV);
+            sched_launch(&cur_proc->sched_esp, "shell", i);
+            return;
+        }
+    }
+    sched_booting = 0;
+
+    if (cur_proc != SCHED_IDLE_PCB && cur_proc->on_run_queue) {
+        /* Let the current task finish its time slice */
+        if (cur_proc->slice_left > elapsed) {
+            cur_proc->slice_left -= elapsed;
+            pit_arm_for(cur_proc);
+            return;
+        }
+        next_proc = cur_proc->run_next;
+    } else {
+        next_proc = run_queue ? run_queue : SCHED_IDLE_PCB;
     }
-    else{
-        next_pid = terms[cur_proc_ind].cur_pid;
+    /* Remember where round robin left off for when we come back from idle */
+    if (next_proc != SCHED_IDLE_PCB) {
+        run_queue = next_proc;
     }
 
     /* Return if there is no other process to schedule */
-    if(cur_proc->pid == next_pid){
+    if (next_proc == cur_proc) {
+        if (cur_proc != SCHED_IDLE_PCB) {
+            cur_proc->slice_left = cur_proc->priority * sched_quantum;
+        }
+        pit_arm_for(cur_proc);
         return;
     }
 
-    PCB_t* next_proc = (PCB_t *) TASK_KSTACK_TOP(next_pid);
-
-    /* Setup next process's paging */
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = TASK_PAGE_INDEX(next_pid);
-    if(next_proc->term_ind != cur_term_ind){
-        user_vidmem_page_table[0].page_addr = BACKGROUND_1 + next_proc->term_ind;
-    }
-    else{
-        user_vidmem_page_table[0].page_addr = VID_MEM_ADDR;
-    }
-    tss.esp0 = TASK_KSTACK_BOT(next_pid);
-    tss.ss0 = KERNEL_DS;
-    /* Flush TLB */
-    asm volatile(
-        " movl %0, %%cr3; "
-        :
-        : "r"(page_directory)
-    );
-
-    /* save current esp and ebp */
-    asm volatile(
-        " movl %%esp, %0; "
-        " movl %%ebp, %1; "
-        : "=m" (cur_proc->esp), "=m" (cur_proc->ebp)
-    );
-
-    /* Restore next process's esp and ebp */
-    asm volatile(
-        " movl %0, %%esp; "
-        " movl %1, %%ebp; "
-        :
-        : "m" (next_proc->esp), "m" (next_proc->ebp)
-    );
+    sched_switch_to(cur_proc, next_proc);
 }
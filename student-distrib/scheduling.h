@@ -18,11 +18,70 @@
 #define PIT_DATA0_PORT     0x40
 #define PIT_CMD_REG        0x43
 
-#define PIT_MODE3          0x36
+// Channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count)
+#define PIT_MODE0          0x30
+// Read-back command latching status and count of channel 0
+#define PIT_READBACK_CH0   0xC2
+// Status bit mirroring the OUT pin; set once a mode 0 count has expired
+#define PIT_STATUS_OUT     0x80
+#define PIT_MAX_COUNT      0xFFFF
+#define PIT_CLOCKS_PER_MS  (CLOCK_TICK_RATE / 1000)
 
 #define PIT_IRQNUM         0
 
+// The PIT is a one-shot timer armed for the next deadline only: the end of
+// the running task's time slice. It is left stopped while a single task
+// or nothing at all is runnable. `pit_ticks' still advances in ~30 ms units
+// of timer-covered time.
+
+// A task runs for `priority * sched_quantum' PIT clocks before it is
+// preempted, so a higher priority buys a longer time slice
+#define SCHED_QUANTUM_DEF  _33HZ_DIV
+#define SCHED_QUANTUM_MIN  PIT_CLOCKS_PER_MS
+#define SCHED_PRIO_MIN     1
+#define SCHED_PRIO_MAX     8
+#define SCHED_PRIO_DEF     1
+
+// The boot context doubles as the idle task; it runs only when the run
+// queue is empty
+#define SCHED_IDLE_PCB     ((PCB_t *) TASK_KSTACK_TOP(0))
+
+typedef struct {
+    uint32_t switches;          // Context switches performed
+    uint32_t dispatches;        // Times a runnable task was given the CPU
+    uint32_t latency_total;     // Sum of runnable-to-running delays, in cycles
+    uint32_t latency_max;       // Longest runnable-to-running delay, in cycles
+    uint32_t cr3_loads;         // Switches that had to change address space
+    uint32_t switch_cycles;     // Sum of stack switch to resume times, in cycles
+    uint32_t switch_max;        // Longest stack switch to resume time, in cycles
+} sched_stats_t;
+
+// Elapsed timer time in ~30 ms units; used as a coarse clock by tests.c.
+// Time spent with the timer stopped is not counted
+extern volatile uint32_t pit_ticks;
+// Number of PIT interrupts since boot
+extern volatile uint32_t pit_interrupts;
+// Stop the timer while the CPU is idle; tests.c clears it to keep a clock
+extern uint8_t pit_nohz;
+
+extern uint32_t sched_quantum;
+extern sched_stats_t sched_stats;
+
 void init_pit(void);
 void pit_isr(void);
+void pit_kick(void);
+
+void sched_init_task(PCB_t *pcb);
+void sched_enqueue(PCB_t *pcb);
+void sched_dequeue(PCB_t *pcb);
+void sched_set_quantum(uint32_t clocks);
+int32_t sched_set_priority(PCB_t *pcb, uint8_t priority);
+void sched_sleep_on(wait_queue_t *wq);
+void sched_exit(PCB_t *pcb);
+void sched_wake_up(wait_queue_t *wq);
+void sched_idle(void);
+
+extern void sched_switch(uint8_t **save_esp, uint8_t *next_esp);
+extern int32_t sched_launch(uint8_t **save_esp, const int8_t *command, int32_t term_ind);
 
 #endif
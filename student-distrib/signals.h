@@ -27,6 +27,7 @@ typedef struct {
 #define SIG_FLAG(s) (1 << s)
 
 void check_signals(hw_context_t *context);
+int32_t signals_pending(void);
 extern int sigreturn_linkage();
 
 #endif
@@ -5,9 +5,17 @@
 #include "rtc.h"
 #include "file_sys.h"
 #include "x86_desc.h"
+#include "exec_cache.h"
+#include "scheduling.h"
+#include "frame.h"
 
-uint8_t pid_used[MAX_PROC_NUM] = {0};
-malloc_obj_t *malloc_objs = (malloc_obj_t *) MALLOC_HEAP_MAP_START;
+PCB_t *task_pcbs[MAX_PROC_NUM] = {NULL};
+task_mem_stats_t task_mem_stats;
+malloc_state_t *malloc_state = (malloc_state_t *) MALLOC_HEAP_MAP_START;
+
+#define MALLOC_TAG(blk) (*(uint32_t *) (blk))
+#define MALLOC_SIZE(blk) (MALLOC_TAG(blk) & ~MALLOC_TAG_USED)
+#define MALLOC_FTR(blk) (*(uint32_t *) ((uint8_t *) (blk) + MALLOC_SIZE(blk) - MALLOC_FTR_SIZE))
 
 int32_t syscall_halt(uint8_t status) {
     return _syscall_halt(status, (hw_context_t *) (((uint32_t *) &status) + 3));
@@ -17,7 +25,7 @@ int32_t _syscall_halt(uint32_t status, hw_context_t *context) {
     // Revert info from PCB
     PCB_t *task_pcb = get_cur_pcb();
     PCB_t *parent_pcb = task_pcb->parent;
-    if (!parent_pcb) {
+    if (!parent_pcb && !task_pcb->fork_ppid) {
         uint32_t entry_addr;
         entry_addr = *((int32_t *) (TASK_IMG_START_ADDR + ELF_ENTRY_OFFSET));
         context->addr = (void *) entry_addr;
@@ -32,20 +40,34 @@ int32_t _syscall_halt(uint32_t status, hw_context_t *context) {
         }
     }
 
+    if (task_pcb->fork_ppid) {
+        // Nobody waits for a forked task. Hand the terminal back to the
+        // task that forked it, then free everything and never come back
+        uint8_t fork_ppid = task_pcbs[task_pcb->fork_ppid] ? task_pcb->fork_ppid : 0;
+        if (terms[task_pcb->term_ind].cur_pid == task_pcb->pid) {
+            terms[task_pcb->term_ind].cur_pid = fork_ppid;
+        }
+        task_pcbs[task_pcb->pid] = NULL;
+        page_dir_load(page_directory);
+        page_dir_free(task_pcb->page_dir);
+        frame_free_contig((uint32_t) task_pcb, TASK_KSTACK_FRAMES);
+        sched_exit(task_pcb);
+    }
+
     int32_t ppid = parent_pcb->pid;
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = TASK_PAGE_INDEX(ppid);
-    tss.esp0 = TASK_KSTACK_BOT(ppid);
-    // Reload the TLB
-    asm volatile(
-        "movl %%cr3, %%eax;"
-        " movl %0, %%cr3; "
-        :
-        : "r"(page_directory)
-        :"%eax"
-    );
+    page_dir_load(parent_pcb->page_dir);
+    tss.esp0 = PCB_KSTACK_BOT(parent_pcb);
 
-    pid_used[task_pcb->pid] = 0;
+    task_pcbs[task_pcb->pid] = NULL;
     terms[task_pcb->term_ind].cur_pid = ppid;
+    // The parent takes over the terminal's place on the run queue
+    sched_dequeue(task_pcb);
+    sched_enqueue(parent_pcb);
+    // Give back the task's memory. We keep running on its kernel stack
+    // until the jump below, which is safe as nothing can allocate with
+    // interrupts off
+    page_dir_free(task_pcb->page_dir);
+    frame_free_contig((uint32_t) task_pcb, TASK_KSTACK_FRAMES);
     uint32_t prev_ebp = (uint32_t) parent_pcb->ebp;
     uint32_t prev_esp = (uint32_t) parent_pcb->esp;
     asm volatile (
@@ -65,6 +87,49 @@ int32_t _syscall_halt(uint32_t status, hw_context_t *context) {
     return 0;
 }
 
+/* task_page_fault
+ *  Descrption: Resolves the first touch of a user page of the running
+ *      task. Pages covering the program image are read from the file;
+ *      everything past it (bss, heap, stack) starts out zeroed. Writes to
+ *      pages shared since a fork get a private copy
+ *  Arg:
+ *      addr: faulting address from cr2
+ *      errorcode: error code pushed by the CPU
+ *  RETURN: 0 if the access can be retried, -1 on a real fault
+ */
+int32_t task_page_fault(uint32_t addr, uint32_t errorcode) {
+    PCB_t *task_pcb = get_cur_pcb();
+    uint8_t *frame;
+    uint32_t page = addr & ~(PAGE_SIZE - 1);
+    int32_t filled = 0;
+
+    if (errorcode & PF_ERR_PRESENT) {
+        filled = page_user_cow(addr, errorcode);
+        if (filled < 0) {
+            return -1;
+        }
+        if (filled) {
+            task_mem_stats.cow_copies++;
+        } else {
+            task_mem_stats.cow_reuses++;
+        }
+        return 0;
+    }
+    frame = page_user_alloc(addr, errorcode);
+    if (!frame) {
+        return -1;
+    }
+    // TASK_IMG_START_ADDR is page aligned, so pages never straddle it
+    if (page >= TASK_IMG_START_ADDR && page < TASK_IMG_START_ADDR + task_pcb->img_size) {
+        filled = read_data(task_pcb->img_inode, page - TASK_IMG_START_ADDR, (int8_t *) frame, PAGE_SIZE);
+        task_mem_stats.image_fills++;
+    } else {
+        task_mem_stats.zero_fills++;
+    }
+    memset(frame + filled, 0, PAGE_SIZE - filled);
+    return 0;
+}
+
 int32_t syscall_execute(const int8_t *command) {
     return _syscall_execute(command, -1);
 }
@@ -72,7 +137,7 @@ int32_t syscall_execute(const int8_t *command) {
 int32_t _syscall_execute(const int8_t* command, int8_t term_ind) {
     int pid;
     for (pid = 1; pid < MAX_PROC_NUM; pid ++) {
-        if (!pid_used[pid]) {
+        if (!task_pcbs[pid]) {
             goto syscall_execute__parse_args;
         }
     }
@@ -106,49 +171,57 @@ syscall_execute__parse_args:;
 
     int32_t entry_addr;
     // 3. Check executable format and load task image
-    FILE f;
-    if (fs_open(filename, &f) == -1) {
+    dentry_t dent;
+    if (read_dentry_by_name(filename, &dent) || dent.filetype != FILE_TYPE_REG) {
         return -1;
     }
 
-    int8_t buf[BUF_SIZE];
-    int32_t read_size = fs_file_read(buf, BUF_SIZE, &f);
-    // Check for ELF magic
-    if (buf[0] != 0x7F || buf[1] != 'E' || buf[2] != 'L' || buf[3] != 'F') {
-        fs_file_close(&f);
-        return -1;
+    // A cached program has already been validated
+    exec_cache_entry_t *cached = exec_cache_lookup(dent.inode_num);
+    if (cached) {
+        entry_addr = cached->entry;
+    } else {
+        int8_t elf_header[ELF_HEADER_SIZE];
+        if (read_data(dent.inode_num, 0, elf_header, ELF_HEADER_SIZE) != ELF_HEADER_SIZE) {
+            return -1;
+        }
+        // Check for ELF magic
+        if (elf_header[0] != 0x7F || elf_header[1] != 'E' || elf_header[2] != 'L' || elf_header[3] != 'F') {
+            return -1;
+        }
+
+        entry_addr = *((int32_t *) (elf_header + ELF_ENTRY_OFFSET));
+        // Check that the entry address is after the image starting point
+        if (entry_addr < TASK_IMG_START_ADDR) {
+            return -1;
+        }
     }
 
-    entry_addr = *((int32_t *) (buf + ELF_ENTRY_OFFSET));
-    // Check that the entry address is after the image starting point
-    if (entry_addr < TASK_IMG_START_ADDR) {
-        fs_file_close(&f);
+    // 4. Setup paging; the task gets its own page directory and kernel
+    // stack. Make sure the image can be faulted in before starting
+    PCB_t *cur_pcb = get_cur_pcb();
+    uint8_t task_term_ind = term_ind != -1 ? term_ind : cur_pcb->term_ind;
+    if (frame_free_count < TASK_MIN_FRAMES + (inode_size(dent.inode_num) >> ADDRESS_SHIFT) + 1) {
         return -1;
     }
-
-    // 4. Setup paging; Set task's target page address
-    page_directory[USER_PAGE_INDEX].page_PDE.page_addr = TASK_PAGE_INDEX(pid);
-    // Reload the TLB
-    asm volatile(
-        " movl %0, %%cr3; "
-        :
-        : "r"(page_directory)
-    );
-
-    // Copy the rest of the image
-    uint8_t *task_img_cur = (uint8_t *) TASK_IMG_START_ADDR;
-    memcpy(task_img_cur, buf, read_size);
-    task_img_cur += read_size;
-    while ((read_size = fs_file_read(buf, BUF_SIZE, &f)) > 0) {
-        memcpy(task_img_cur, buf, read_size);
-        task_img_cur += read_size;
+    PCB_t *task_pcb = (PCB_t *) frame_alloc_contig(TASK_KSTACK_FRAMES);
+    if (!task_pcb) {
+        return -1;
+    }
+    PDE_t *task_page_dir = page_dir_setup(task_term_ind);
+    if (!task_page_dir) {
+        frame_free_contig((uint32_t) task_pcb, TASK_KSTACK_FRAMES);
+        return -1;
     }
+    page_dir_load(task_page_dir);
 
-    fs_file_close(&f);
+    // Nothing is copied here; image pages are read from the file system's
+    // data blocks on first access. The cache only remembers the header check
+    if (!cached) {
+        exec_cache_insert(dent.inode_num, entry_addr);
+    }
 
     // 5. Setup PCB
-    PCB_t *cur_pcb = get_cur_pcb();
-    PCB_t *task_pcb = (PCB_t *) TASK_KSTACK_TOP(pid);
     // Open stdin & stdout
     task_pcb->open_files[0].flags.used = 1;
     task_pcb->open_files[0].flags.type = TASK_FILE_TERM;
@@ -162,35 +235,45 @@ syscall_execute__parse_args:;
     }
 
     task_pcb->cmd_args = args ? copied_args : NULL;
-    asm volatile ("movl %%ebp, %0;" : "=r" (cur_pcb->ebp));
-    asm volatile ("movl %%esp, %0;" : "=r" (cur_pcb->esp));
     if (cur_pcb != (PCB_t *) TASK_KSTACK_TOP(0) && term_ind == -1) {
+        // Halt resumes the parent from here
+        asm volatile ("movl %%ebp, %0;" : "=r" (cur_pcb->ebp));
+        asm volatile ("movl %%esp, %0;" : "=r" (cur_pcb->esp));
         task_pcb->parent = cur_pcb;
     } else {
         task_pcb->parent = NULL;
     }
     task_pcb->pid = pid;
     task_pcb->signals = 0;
-    task_pcb->malloc_obj_count = 1;
-    task_pcb->term_ind = term_ind != -1 ? term_ind : cur_pcb->term_ind;
-    malloc_objs[0].used = 0;
-    malloc_objs[0].size = MALLOC_HEAP_SIZE;
-
-    if (term_ind != -1) {
-        terms[(int) term_ind].cur_pid = pid;
-    } else {
-        terms[cur_pcb->term_ind].cur_pid = pid;
+    task_pcb->term_ind = task_term_ind;
+    task_pcb->page_dir = task_page_dir;
+    task_pcb->img_inode = dent.inode_num;
+    task_pcb->img_size = inode_size(dent.inode_num);
+    if (task_pcb->img_size > TASK_IMG_MAX_SIZE) {
+        task_pcb->img_size = TASK_IMG_MAX_SIZE;
     }
+    task_pcb->exec_tsc = rdtsc();
+    task_pcb->fork_ppid = 0;
+    malloc_init();
+
+    terms[task_term_ind].cur_pid = pid;
 
-    tss.esp0 = TASK_KSTACK_BOT(pid);
+    tss.esp0 = PCB_KSTACK_BOT(task_pcb);
     tss.ss0 = KERNEL_DS;
 
-    pid_used[pid] = 1;
+    task_pcbs[pid] = task_pcb;
 
     for (i = 0; i < SIG_SIZE; i ++) {
         task_pcb->signal_handlers[i] = NULL;
     }
 
+    // The parent sleeps in execute until the child halts
+    sched_init_task(task_pcb);
+    if (task_pcb->parent) {
+        sched_dequeue(task_pcb->parent);
+    }
+    sched_enqueue(task_pcb);
+
     // 6. Context switch
     asm volatile (
         "movl %0, %%eax;"  // User DS
@@ -219,6 +302,86 @@ syscall_execute__parse_args:;
     return retval;
 }
 
+/* _syscall_fork
+ *  Descrption: Duplicate the calling task. The child shares every user page
+ *      with the parent until one of them writes to it (see page_dir_fork),
+ *      inherits the open files and signal handlers, and is queued to
+ *      return from the same fork call with 0
+ *
+ *  Arg:
+ *      context: the parent's syscall frame; see syscall_fork in idt_asm.S
+ *
+ * 	RETURN:
+ *      pid of the child in the parent, 0 in the child, -1 if failed
+ */
+int32_t _syscall_fork(hw_context_t *context) {
+    PCB_t *cur_pcb = get_cur_pcb();
+    int pid;
+    int i;
+
+    // Only user tasks have a full frame (with esp and ss) to copy
+    if (context->cs != USER_CS) {
+        return -1;
+    }
+    for (pid = 1; pid < MAX_PROC_NUM && task_pcbs[pid]; pid ++);
+    if (pid == MAX_PROC_NUM || frame_free_count < TASK_MIN_FRAMES) {
+        return -1;
+    }
+    PCB_t *task_pcb = (PCB_t *) frame_alloc_contig(TASK_KSTACK_FRAMES);
+    if (!task_pcb) {
+        return -1;
+    }
+    PDE_t *task_page_dir = page_dir_fork(cur_pcb->page_dir, cur_pcb->term_ind);
+    if (!task_page_dir) {
+        frame_free_contig((uint32_t) task_pcb, TASK_KSTACK_FRAMES);
+        return -1;
+    }
+
+    memcpy(task_pcb, cur_pcb, sizeof(PCB_t));
+    task_pcb->pid = pid;
+    task_pcb->parent = NULL;
+    task_pcb->fork_ppid = cur_pcb->pid;
+    task_pcb->signals = 0;
+    task_pcb->exec_tsc = 0;
+    task_pcb->page_dir = task_page_dir;
+    // The arguments live in the parent's execute frame, which may be gone
+    // before the child asks for them; keep a copy right above the PCB
+    if (cur_pcb->cmd_args) {
+        int8_t *args = (int8_t *) (task_pcb + 1);
+        strncpy(args, cur_pcb->cmd_args, BUF_SIZE);
+        args[BUF_SIZE - 1] = 0;
+        task_pcb->cmd_args = args;
+    }
+    // RTC files are registered with the driver by address
+    for (i = 2; i < TASK_MAX_FILES; i ++) {
+        FILE *file = &task_pcb->open_files[i];
+        if (file->flags.used && file->flags.type == TASK_FILE_RTC) {
+            rtc_open("", file);
+            file->inode = cur_pcb->open_files[i].inode;
+            file->pos = cur_pcb->open_files[i].pos;
+        }
+    }
+
+    // The child's kernel stack holds a copy of the parent's syscall frame
+    // returning 0, and below it a context sched_switch resumes into
+    // fork_linkage, which leaves through the normal syscall exit
+    hw_context_t *child_context = (hw_context_t *) (PCB_KSTACK_BOT(task_pcb) - sizeof(hw_context_t));
+    memcpy(child_context, context, sizeof(hw_context_t));
+    child_context->regs[6] = 0;     // eax
+    uint32_t *child_esp = (uint32_t *) (PCB_KSTACK_BOT(task_pcb) - sizeof(hw_context_t));
+    *(--child_esp) = (uint32_t) fork_linkage;
+    for (i = 0; i < 4; i ++) {      // ebp, ebx, esi, edi
+        *(--child_esp) = 0;
+    }
+    task_pcb->sched_esp = (uint8_t *) child_esp;
+
+    task_pcbs[pid] = task_pcb;
+    sched_init_task(task_pcb);
+    task_pcb->priority = cur_pcb->priority;
+    sched_enqueue(task_pcb);
+    return pid;
+}
+
 int32_t syscall_read(int32_t fd, void *buf, uint32_t nbytes) {
     if (!buf) {
         return -1;
@@ -236,6 +399,19 @@ int32_t syscall_read(int32_t fd, void *buf, uint32_t nbytes) {
             buf, nbytes, &task_pcb->open_files[fd]);
 }
 
+/* Records how long the task took to start writing output */
+static void task_note_write(PCB_t *task_pcb) {
+    if (task_pcb->exec_tsc) {
+        uint32_t startup = rdtsc() - task_pcb->exec_tsc;
+        task_pcb->exec_tsc = 0;
+        task_mem_stats.first_writes++;
+        task_mem_stats.first_write_total += startup;
+        if (startup > task_mem_stats.first_write_max) {
+            task_mem_stats.first_write_max = startup;
+        }
+    }
+}
+
 int32_t syscall_write(int32_t fd, const void *buf, uint32_t nbytes) {
     if (!buf) {
         return -1;
@@ -246,6 +422,7 @@ int32_t syscall_write(int32_t fd, const void *buf, uint32_t nbytes) {
     }
 
     PCB_t *task_pcb = get_cur_pcb();
+    task_note_write(task_pcb);
     if (!task_pcb->open_files[fd].flags.used) {
         return -1;
     }
@@ -253,6 +430,154 @@ int32_t syscall_write(int32_t fd, const void *buf, uint32_t nbytes) {
             buf, nbytes, &task_pcb->open_files[fd]);
 }
 
+/* syscall_readv
+ *  Descrption: Read into several buffers with one syscall, calling the
+ *      file's read once per segment in order
+ *
+ *  Arg:
+ *      fd: file descriptor
+ *      iov: the buffers
+ *      iovcnt: number of buffers, at most IOV_MAX
+ *  RETURN: total bytes read, which stops short after a short read; -1 if
+ *      the arguments are bad or the first read fails
+ */
+int32_t syscall_readv(int32_t fd, const iovec_t *iov, int32_t iovcnt) {
+    int32_t i, ret, total = 0;
+    if (!iov || iovcnt < 0 || iovcnt > IOV_MAX) {
+        return -1;
+    }
+
+    if (fd < 0 || fd >= TASK_MAX_FILES) {
+        return -1;
+    }
+
+    PCB_t *task_pcb = get_cur_pcb();
+    FILE *file = &task_pcb->open_files[fd];
+    if (!file->flags.used) {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (!iov[i].base) {
+            return total ? total : -1;
+        }
+        ret = file->file_ops->read(iov[i].base, iov[i].len, file);
+        if (ret < 0) {
+            return total ? total : -1;
+        }
+        total += ret;
+        if ((uint32_t) ret < iov[i].len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/* syscall_writev
+ *  Descrption: Write several buffers with one syscall, calling the file's
+ *      write once per segment in order
+ *
+ *  Arg:
+ *      fd: file descriptor
+ *      iov: the buffers
+ *      iovcnt: number of buffers, at most IOV_MAX
+ *  RETURN: total bytes written, which stops short after a short write; -1
+ *      if the arguments are bad or the first write fails
+ */
+int32_t syscall_writev(int32_t fd, const iovec_t *iov, int32_t iovcnt) {
+    int32_t i, ret, total = 0;
+    if (!iov || iovcnt < 0 || iovcnt > IOV_MAX) {
+        return -1;
+    }
+
+    if (fd < 0 || fd >= TASK_MAX_FILES) {
+        return -1;
+    }
+
+    PCB_t *task_pcb = get_cur_pcb();
+    task_note_write(task_pcb);
+    FILE *file = &task_pcb->open_files[fd];
+    if (!file->flags.used) {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (!iov[i].base) {
+            return total ? total : -1;
+        }
+        ret = file->file_ops->write(iov[i].base, iov[i].len, file);
+        if (ret < 0) {
+            return total ? total : -1;
+        }
+        total += ret;
+        if ((uint32_t) ret < iov[i].len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/* syscall_ring_setup
+ *  Descrption: Empty the task's batched syscall ring. The page is zero
+ *      filled on first touch like the rest of the user page, and a forked
+ *      child gets a copy
+ *
+ *  RETURN: user address of the ring
+ */
+syscall_ring_t *syscall_ring_setup(void) {
+    syscall_ring_t *ring = (syscall_ring_t *) RING_ADDR;
+    ring->sq_head = ring->sq_tail = 0;
+    ring->cq_head = ring->cq_tail = 0;
+    return ring;
+}
+
+/* syscall_ring_enter
+ *  Descrption: Run queued operations in order against the task's open
+ *      files, as read, write, open and close would, and post a completion
+ *      for each. Stops early when the completion queue is full
+ *
+ *  Arg:
+ *      to_submit: most operations to run
+ *  RETURN: number of operations run; -1 if the ring indices are corrupt
+ */
+int32_t syscall_ring_enter(uint32_t to_submit) {
+    syscall_ring_t *ring = (syscall_ring_t *) RING_ADDR;
+    uint32_t head = ring->sq_head, tail = ring->sq_tail;
+    uint32_t cq_tail = ring->cq_tail;
+    uint32_t done = 0;
+    ring_sqe_t sqe;
+    int32_t res;
+
+    if (tail - head > RING_ENTRIES || cq_tail - ring->cq_head > RING_ENTRIES) {
+        return -1;
+    }
+    while (head != tail && done < to_submit && cq_tail - ring->cq_head < RING_ENTRIES) {
+        // Copy it out; the task owns the queue memory
+        sqe = ring->sq[head % RING_ENTRIES];
+        switch (sqe.op) {
+            case RING_OP_READ:
+                res = syscall_read(sqe.fd, sqe.buf, sqe.len);
+                break;
+            case RING_OP_WRITE:
+                res = syscall_write(sqe.fd, sqe.buf, sqe.len);
+                break;
+            case RING_OP_OPEN:
+                res = syscall_open(sqe.buf);
+                break;
+            case RING_OP_CLOSE:
+                res = syscall_close(sqe.fd);
+                break;
+            default:
+                res = -1;
+                break;
+        }
+        ring->cq[cq_tail % RING_ENTRIES].user_data = sqe.user_data;
+        ring->cq[cq_tail % RING_ENTRIES].res = res;
+        ring->cq_tail = ++cq_tail;
+        ring->sq_head = ++head;
+        done++;
+    }
+    return done;
+}
+
 /* syscall_open
  *  Descrption: Add file descriptor on a process's PCB
  *
@@ -341,6 +666,106 @@ int32_t syscall_vidmap(uint8_t** screen_start) {
     return (int32_t) *screen_start;
 }
 
+/* syscall_mmap
+ *  Descrption: Map an open regular file into the task read-only, one page
+ *      per data block, so it can be scanned without read copying it. The
+ *      pages are the file system's own blocks: later writes to the file
+ *      show through, but the mapping keeps the length the file had here.
+ *      Mappings last until the task halts and are inherited by fork
+ *
+ *  Arg:
+ *      fd: file descriptor of a regular file
+ *      start: where to store the address of the first byte
+ *  RETURN: length of the file in bytes, with *start left alone if it is
+ *      empty; -1 if the arguments are bad or the mmap area is full
+ */
+int32_t syscall_mmap(int32_t fd, uint8_t **start) {
+    PCB_t *task_pcb = get_cur_pcb();
+    uint32_t length, count, addr, i;
+
+    if ((uint32_t) start < TASK_VIRT_PAGE_BEG
+            || (uint32_t) start > TASK_VIRT_PAGE_END - sizeof(*start)) {
+        return -1;
+    }
+    if (fd < 0 || fd >= TASK_MAX_FILES || !task_pcb->open_files[fd].flags.used
+            || task_pcb->open_files[fd].flags.type != TASK_FILE_REG) {
+        return -1;
+    }
+    length = inode_size(task_pcb->open_files[fd].inode);
+    if (!length) {
+        return 0;
+    }
+    count = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (!(addr = page_mmap_reserve(count))) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        page_mmap_block(addr + i * PAGE_SIZE, inode_block(task_pcb->open_files[fd].inode, i));
+    }
+    *start = (uint8_t *) addr;
+    return length;
+}
+
+/* syscall_lseek
+ *  Descrption: Move the position of an open regular file, so the next
+ *      read or write starts there without reading up to it
+ *
+ *  Arg:
+ *      fd: file descriptor of a regular file
+ *      offset: where to move to, relative to `whence'
+ *      whence: SEEK_SET, SEEK_CUR or SEEK_END
+ *  RETURN: the new position; -1 if the arguments are bad
+ */
+int32_t syscall_lseek(int32_t fd, int32_t offset, int32_t whence) {
+    PCB_t *task_pcb = get_cur_pcb();
+
+    if (fd < 0 || fd >= TASK_MAX_FILES || !task_pcb->open_files[fd].flags.used
+            || task_pcb->open_files[fd].flags.type != TASK_FILE_REG) {
+        return -1;
+    }
+    return fs_file_lseek(&task_pcb->open_files[fd], offset, whence);
+}
+
+/* syscall_pread
+ *  Descrption: Read from an open regular file at `offset', leaving its
+ *      position alone. The fourth argument comes in %esi, so the user stub
+ *      always enters through int $0x80
+ *
+ *  Arg:
+ *      fd: file descriptor of a regular file
+ *      buf: buffer to read into
+ *      nbytes: most bytes to read
+ *      offset: where in the file to start
+ *  RETURN: bytes read, 0 at or past the end; -1 if the arguments are bad
+ */
+int32_t syscall_pread(int32_t fd, void *buf, uint32_t nbytes, uint32_t offset) {
+    PCB_t *task_pcb = get_cur_pcb();
+
+    if (!buf) {
+        return -1;
+    }
+    if (fd < 0 || fd >= TASK_MAX_FILES || !task_pcb->open_files[fd].flags.used
+            || task_pcb->open_files[fd].flags.type != TASK_FILE_REG) {
+        return -1;
+    }
+    return fs_file_pread(buf, nbytes, offset, &task_pcb->open_files[fd]);
+}
+
+/* syscall_set_priority
+ *  Descrption: Set the calling task's priority, the number of quanta it
+ *      runs per time slice; takes effect from its next time slice
+ *
+ *  Arg:
+ *      priority: SCHED_PRIO_MIN to SCHED_PRIO_MAX
+ *  RETURN: 0 on success, -1 if the priority is out of range
+ */
+int32_t syscall_set_priority(int32_t priority) {
+    if (priority < SCHED_PRIO_MIN || priority > SCHED_PRIO_MAX) {
+        return -1;
+    }
+    return sched_set_priority(get_cur_pcb(), priority);
+}
+
 int32_t syscall_set_handler(int32_t signum, void* handler) {
     if (signum < 0 || signum > SIG_SIZE) {
         return -1;
@@ -363,79 +788,219 @@ int32_t _syscall_sigreturn(hw_context_t *context) {
     return 0;
 }
 
+/* malloc_class
+ *  Descrption: Size class of a block; floor(log2) of its size in blocks
+ */
+static uint32_t malloc_class(uint32_t size) {
+    uint32_t blocks = size / MALLOC_BLOCK_SIZE;
+    uint32_t c = 0;
+    while (blocks >>= 1) {
+        c ++;
+    }
+    return c < MALLOC_CLASS_NUM ? c : MALLOC_CLASS_NUM - 1;
+}
+
+/* malloc_set_tags
+ *  Descrption: Write the header and footer of a block
+ */
+static void malloc_set_tags(uint8_t *blk, uint32_t size, uint32_t used) {
+    MALLOC_TAG(blk) = size | used;
+    MALLOC_FTR(blk) = size | used;
+}
+
+/* malloc_free_ok
+ *  Descrption: Check a free block pointer read from the user page, which
+ *      the task can scribble on. It must sit on a block boundary inside
+ *      the heap, and its header and footer must agree on a free size that
+ *      keeps it inside the heap
+ *
+ * 	RETURN: 1 if `blk' can be used, 0 otherwise
+ */
+static int32_t malloc_free_ok(const malloc_free_t *blk) {
+    uint32_t addr = (uint32_t) blk;
+    if (addr < HEAP_START || addr >= HEAP_END || (addr - HEAP_START) % MALLOC_BLOCK_SIZE) {
+        return 0;
+    }
+    // A multiple of the block size also has the used bit clear
+    if (!blk->tag || blk->tag % MALLOC_BLOCK_SIZE || blk->tag > HEAP_END - addr) {
+        return 0;
+    }
+    return MALLOC_FTR(blk) == blk->tag;
+}
+
+/* malloc_links_ok
+ *  Descrption: Check that the neighbours of a valid free block are valid
+ *      free blocks that link back to it, so unlinking it only writes to
+ *      the heap and the list heads
+ *
+ * 	RETURN: 1 if `blk' can be unlinked, 0 otherwise
+ */
+static int32_t malloc_links_ok(const malloc_free_t *blk) {
+    if (blk->next && (!malloc_free_ok(blk->next) || blk->next->prev != blk)) {
+        return 0;
+    }
+    if (blk->prev) {
+        return malloc_free_ok(blk->prev) && blk->prev->next == blk;
+    }
+    return malloc_state->free_lists[malloc_class(blk->tag)] == blk;
+}
+
+static int32_t malloc_list_push(malloc_free_t *blk) {
+    malloc_free_t **head = &malloc_state->free_lists[malloc_class(blk->tag)];
+    if (*head && !malloc_free_ok(*head)) {
+        return -1;
+    }
+    blk->prev = NULL;
+    blk->next = *head;
+    if (*head) {
+        (*head)->prev = blk;
+    }
+    *head = blk;
+    return 0;
+}
+
+static int32_t malloc_list_remove(malloc_free_t *blk) {
+    if (!malloc_free_ok(blk) || !malloc_links_ok(blk)) {
+        return -1;
+    }
+    if (blk->prev) {
+        blk->prev->next = blk->next;
+    } else {
+        malloc_state->free_lists[malloc_class(blk->tag)] = blk->next;
+    }
+    if (blk->next) {
+        blk->next->prev = blk->prev;
+    }
+    return 0;
+}
+
+/* malloc_init
+ *  Descrption: Reset the current task's heap to a single free block
+ */
+void malloc_init(void) {
+    uint32_t c;
+    for (c = 0; c < MALLOC_CLASS_NUM; c ++) {
+        malloc_state->free_lists[c] = NULL;
+    }
+    malloc_set_tags((uint8_t *) HEAP_START, MALLOC_HEAP_SIZE * MALLOC_BLOCK_SIZE, 0);
+    malloc_list_push((malloc_free_t *) HEAP_START);
+}
+
+/* syscall_malloc
+ *  Descrption: Allocate from the current task's heap. Looks at the size
+ *      class of the request first; any block in a larger class is big
+ *      enough, so at most one list is searched past its head. The lists
+ *      live in the user page, so every block is checked before it is used
+ *      and a walk stops after as many blocks as the heap can hold.
+ *
+ *  Arg:
+ *      size: number of bytes wanted
+ *
+ * 	RETURN:
+ *      pointer to the object, NULL if there is no room
+ */
 uint8_t *syscall_malloc(uint32_t size) {
-    uint8_t *obj_ptr = (uint8_t *) HEAP_START;
-    int16_t i;
-    uint32_t total_empty_size = 0;
-    PCB_t *task_pcb = get_cur_pcb();
-    for (i = 0; i < task_pcb->malloc_obj_count; i ++) {
-        uint32_t obj_block_size = malloc_objs[i].size;
-        uint32_t obj_size = obj_block_size * MALLOC_BLOCK_SIZE;
-        if (!malloc_objs[i].used) {
-            if (size < obj_size) {
-                if (task_pcb->malloc_obj_count == MALLOC_OBJ_NUM) {
-                    return NULL;
-                }
-                int16_t j;
-                for (j = task_pcb->malloc_obj_count; j >= i; j --) {
-                    malloc_objs[j + 1] = malloc_objs[j];
-                }
-                malloc_objs[i].used = 1;
-                malloc_objs[i].size = (size / 32) + 1;
-                malloc_objs[i + 1].size = obj_block_size - malloc_objs[i].size;
-                task_pcb->malloc_obj_count ++;
-                return obj_ptr;
+    if (size > MALLOC_HEAP_SIZE * MALLOC_BLOCK_SIZE) {
+        return NULL;
+    }
+    uint32_t need = (size + MALLOC_HDR_SIZE + MALLOC_FTR_SIZE + MALLOC_BLOCK_SIZE - 1)
+        & ~(MALLOC_BLOCK_SIZE - 1);
+
+    uint32_t c, steps;
+    for (c = malloc_class(need); c < MALLOC_CLASS_NUM; c ++) {
+        malloc_free_t *blk;
+        steps = 0;
+        for (blk = malloc_state->free_lists[c]; blk; blk = blk->next) {
+            if (!malloc_free_ok(blk) || ++steps > MALLOC_HEAP_SIZE) {
+                return NULL;
             }
-            if (size > obj_size) {
-                total_empty_size += obj_size;
-                goto probe_next_obj;
+            uint32_t blk_size = blk->tag;
+            if (blk_size < need) {
+                continue;
             }
 
-            malloc_objs[i].used = 1;
-            return obj_ptr;
+            if (malloc_list_remove(blk)) {
+                return NULL;
+            }
+            // Split off the tail if it can hold a block of its own
+            if (blk_size - need >= MALLOC_BLOCK_SIZE) {
+                malloc_free_t *rest = (malloc_free_t *) ((uint8_t *) blk + need);
+                malloc_set_tags((uint8_t *) rest, blk_size - need, 0);
+                if (malloc_list_push(rest)) {
+                    return NULL;
+                }
+                blk_size = need;
+            }
+            malloc_set_tags((uint8_t *) blk, blk_size, MALLOC_TAG_USED);
+            return (uint8_t *) blk + MALLOC_HDR_SIZE;
         }
-probe_next_obj:
-        obj_ptr += malloc_objs[i].size * MALLOC_BLOCK_SIZE;
     }
 
     return NULL;
 }
 
+/* syscall_free
+ *  Descrption: Return an object to the heap, merging it with free neighbours
+ *      found through the boundary tags. Both neighbours are checked before
+ *      anything is written.
+ *
+ *  Arg:
+ *      ptr: pointer returned by syscall_malloc
+ *
+ * 	RETURN:
+ *      0 on success, -1 if ptr is not an allocated object
+ */
 int32_t syscall_free(uint8_t *ptr) {
     if (!ptr) {
         return 0;
     }
-    uint8_t *obj_ptr = (uint8_t *) HEAP_START;
-    uint16_t i;
-    PCB_t *task_pcb = get_cur_pcb();
-    for (i = 0; i < task_pcb->malloc_obj_count && ptr > obj_ptr; i ++) {
-        obj_ptr += malloc_objs[i].size * MALLOC_BLOCK_SIZE;
+    uint8_t *blk = ptr - MALLOC_HDR_SIZE;
+    if ((uint32_t) blk < HEAP_START || (uint32_t) blk >= HEAP_END
+            || ((uint32_t) blk - HEAP_START) % MALLOC_BLOCK_SIZE) {
+        return -1;
     }
-    if (obj_ptr != ptr) {
+    uint32_t tag = MALLOC_TAG(blk);
+    uint32_t size = tag & ~MALLOC_TAG_USED;
+    if (!(tag & MALLOC_TAG_USED) || !size || size % MALLOC_BLOCK_SIZE
+            || size > HEAP_END - (uint32_t) blk
+            || MALLOC_FTR(blk) != tag) {
         return -1;
     }
 
-    uint16_t empty_size = malloc_objs[i].size;
-    uint8_t move = 0;
-    if (i < task_pcb->malloc_obj_count && !malloc_objs[i + 1].used) {
-        move ++;
-        empty_size += malloc_objs[i + 1].size;
+    malloc_free_t *next = (malloc_free_t *) (blk + size);
+    malloc_free_t *prev = NULL;
+    if ((uint32_t) next >= HEAP_END || (MALLOC_TAG(next) & MALLOC_TAG_USED)) {
+        next = NULL;
+    } else if (!malloc_free_ok(next) || !malloc_links_ok(next)) {
+        return -1;
     }
-    if (i > 0 && malloc_objs[i - 1].used == 0) {
-        move ++;
-        empty_size += malloc_objs[i + 1].size;
-        i --;
+    if ((uint32_t) blk > HEAP_START) {
+        uint32_t prev_tag = *(uint32_t *) (blk - MALLOC_FTR_SIZE);
+        if (!(prev_tag & MALLOC_TAG_USED)) {
+            if (prev_tag > (uint32_t) blk - HEAP_START) {
+                return -1;
+            }
+            prev = (malloc_free_t *) (blk - prev_tag);
+            if (!malloc_free_ok(prev) || !malloc_links_ok(prev)) {
+                return -1;
+            }
+        }
     }
 
-    task_pcb->malloc_obj_count -= move;
-    uint16_t j;
-    for (j = i + 1; j < task_pcb->malloc_obj_count; j ++) {
-        malloc_objs[j] = malloc_objs[j + move];
+    if (next) {
+        malloc_list_remove(next);
+        size += next->tag;
+    }
+    if (prev) {
+        if (malloc_list_remove(prev)) {
+            return -1;
+        }
+        blk = (uint8_t *) prev;
+        size += prev->tag;
     }
-    malloc_objs[i].used = 0;
-    malloc_objs[i].size = empty_size;
 
-    return 0;
+    malloc_set_tags(blk, size, 0);
+    return malloc_list_push((malloc_free_t *) blk);
 }
 
 PCB_t *get_cur_pcb() {
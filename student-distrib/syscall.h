@@ -5,25 +5,90 @@
 #include "task.h"
 #include "signals.h"
 
-// Each block has a size of 32-bytes, and the allocator will only allocate
-// multiples of blocks
-// Total amount of heap is 256K, so it doesn't collide with program code
-// A size of 0 means it has *1* block; used blocks can be ajacent to each
-// other (as they represent deifferent allocated objects), but unused
-// blocks can't. Each object can only have 1 block.
+// Segregated-fit heap allocator. The heap is carved into blocks whose sizes
+// are multiples of 32 bytes. Every block starts with an 8-byte header and
+// ends with a 4-byte footer. Both hold the block size in bytes, with the
+// low bit set while the block is in use. Free blocks are kept in doubly
+// linked lists, one per size class. Class k holds blocks of
+// [2^k, 2^(k+1)) * 32 bytes. The list heads live in the map area below the
+// heap. Total amount of heap is 256K, so it doesn't collide with program code
 #define MALLOC_MAP_SIZE 4096
 #define MALLOC_HEAP_SIZE (256 * 1024 / 32)
-#define MALLOC_OBJ_NUM 2048
 #define MALLOC_BLOCK_SIZE 32
+#define MALLOC_CLASS_NUM 14
+#define MALLOC_HDR_SIZE 8
+#define MALLOC_FTR_SIZE 4
+#define MALLOC_TAG_USED 1
 #define MALLOC_HEAP_MAP_START (TASK_VIRT_PAGE_BEG + PCB_SIZE)
-#define HEAP_START (TASK_VIRT_PAGE_BEG + PCB_SIZE + MALLOC_MAP_SIZE)
+#define HEAP_START ((TASK_VIRT_PAGE_BEG + PCB_SIZE + MALLOC_MAP_SIZE + MALLOC_BLOCK_SIZE - 1) \
+        & ~(MALLOC_BLOCK_SIZE - 1))
+#define HEAP_END (HEAP_START + MALLOC_HEAP_SIZE * MALLOC_BLOCK_SIZE)
 #define PCB_SIZE sizeof(PCB_t)
 
 #define ELF_ENTRY_OFFSET 24
+// Enough of the ELF header to check the magic and read the entry point
+#define ELF_HEADER_SIZE (ELF_ENTRY_OFFSET + 4)
+// The image may fill the user page from its start up to the user stack
+#define TASK_IMG_MAX_SIZE (TASK_VIRT_PAGE_END - TASK_IMG_START_ADDR)
+// Frames a task needs besides its image: kernel stack, page directory, user
+// page table, heap map, both ends of the heap and the first stack page
+#define TASK_MIN_FRAMES (TASK_KSTACK_FRAMES + 6)
+// Image pages are only read in as they are touched; see task_page_fault
+
+// Most segments readv and writev take in one call
+#define IOV_MAX 64
+
+// One buffer of a readv or writev
+typedef struct {
+    void *base;
+    uint32_t len;
+} iovec_t;
+
+// Batched syscall ring: one page shared by the task and the kernel, between
+// the heap and the program image. The task queues operations at sq_tail and
+// syscall_ring_enter runs them in order, posting results at cq_tail
+#define RING_ADDR (TASK_IMG_START_ADDR - PAGE_SIZE)
+#define RING_ENTRIES 64
+#define RING_OP_READ 0
+#define RING_OP_WRITE 1
+#define RING_OP_OPEN 2
+#define RING_OP_CLOSE 3
+
+// A queued operation; `buf' is the file name for RING_OP_OPEN
+typedef struct {
+    uint32_t op;
+    int32_t fd;
+    void *buf;
+    uint32_t len;
+    uint32_t user_data;
+} ring_sqe_t;
+
+// Result of an operation, tagged with its user_data
+typedef struct {
+    uint32_t user_data;
+    int32_t res;
+} ring_cqe_t;
+
+// Indices run freely; an entry lives at index % RING_ENTRIES. The task
+// moves sq_tail and cq_head, the kernel sq_head and cq_tail
 typedef struct {
-    uint16_t used : 1;
-    uint16_t size : 15;
-} __attribute__((packed)) malloc_obj_t;
+    volatile uint32_t sq_head, sq_tail;
+    volatile uint32_t cq_head, cq_tail;
+    ring_sqe_t sq[RING_ENTRIES];
+    ring_cqe_t cq[RING_ENTRIES];
+} syscall_ring_t;
+
+// Layout of a free block; `tag' doubles as the header of every block
+typedef struct malloc_free_s {
+    uint32_t tag;
+    uint32_t pad;
+    struct malloc_free_s *next;
+    struct malloc_free_s *prev;
+} malloc_free_t;
+
+typedef struct {
+    malloc_free_t *free_lists[MALLOC_CLASS_NUM];
+} malloc_state_t;
 
 int32_t syscall_halt(uint8_t status);
 int32_t _syscall_halt(uint32_t status, hw_context_t *context);
@@ -40,8 +105,39 @@ extern int32_t syscall_sigreturn(void);
 int32_t _syscall_sigreturn(hw_context_t *context);
 uint8_t *syscall_malloc(uint32_t size);
 int32_t syscall_free(uint8_t *ptr);
+extern int32_t syscall_fork(void);
+int32_t _syscall_fork(hw_context_t *context);
+int32_t syscall_readv(int32_t fd, const iovec_t *iov, int32_t iovcnt);
+int32_t syscall_writev(int32_t fd, const iovec_t *iov, int32_t iovcnt);
+syscall_ring_t *syscall_ring_setup(void);
+int32_t syscall_ring_enter(uint32_t to_submit);
+int32_t syscall_mmap(int32_t fd, uint8_t **start);
+int32_t syscall_lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t syscall_pread(int32_t fd, void *buf, uint32_t nbytes, uint32_t offset);
+int32_t syscall_set_priority(int32_t priority);
+void malloc_init(void);
 PCB_t *get_cur_pcb();
 int32_t do_syscall(int32_t call, int32_t a, int32_t b, int32_t c);
 int32_t init_proc(const int8_t* command, int8_t term_ind);
 
+// PCB of every live task, indexed by pid; NULL for a free pid
+extern PCB_t *task_pcbs[MAX_PROC_NUM];
+
+typedef struct {
+    uint32_t image_fills;       // User pages read in from the program file
+    uint32_t zero_fills;        // User pages zeroed on first touch
+    uint32_t first_writes;      // Tasks that reached their first write
+    uint32_t first_write_total; // Sum of execute to first write times, in cycles
+    uint32_t first_write_max;   // Longest execute to first write time, in cycles
+    uint32_t cow_copies;        // Shared pages copied on a write after fork
+    uint32_t cow_reuses;        // Shared pages whose last owner kept the frame
+} task_mem_stats_t;
+
+// Demand paging statistics; read by tests.c
+extern task_mem_stats_t task_mem_stats;
+
+int32_t task_page_fault(uint32_t addr, uint32_t errorcode);
+// Resumes a forked child on its copy of the parent's syscall frame
+extern void fork_linkage(void);
+
 #endif
@@ -9,20 +9,20 @@
 // Maximum number of files open for each task
 #define TASK_MAX_FILES 8
 #define TASK_MAX_FD    7
-// The starting page index for the first task = 8 MB
-#define TASK_START_PAGE 2
-#define TASK_PAGE_INDEX(c) (TASK_START_PAGE + c)
-
 #define TASK_IMG_START_ADDR 0x08048000
-// Kernel stack top for the task; Also location for PCB
+// Kernel stack top for the boot context (pid 0); Also location for its PCB
 #define TASK_KSTACK_TOP(c) (0x800000 - 0x2000 * (c + 1))
-// Kernel stack bottom (start) for the task
+// Kernel stack bottom (start) for the boot context
 #define TASK_KSTACK_BOT(c) (0x800000 - 0x2000 * (c))
-// User stack bottom (start) for the task
-#define TASK_USTACK_BOT(c) (0x800000 + 0x40000 * (c + 1))
 #define KSTACK_TOP_MASK (~0x1FFF)
+// Every other task gets an 8 KB aligned kernel stack from the frame
+// allocator, with its PCB at the top (lowest address)
+#define TASK_KSTACK_FRAMES 2
+#define TASK_KSTACK_SIZE 0x2000
+#define PCB_KSTACK_BOT(pcb) ((uint32_t) (pcb) + TASK_KSTACK_SIZE)
 
-#define MAX_PROC_NUM 10
+// Size of the pid table; tasks are otherwise only limited by free frames
+#define MAX_PROC_NUM 64
 
 typedef enum {
     TASK_FILE_REG,
@@ -31,6 +31,12 @@ typedef enum {
     TASK_FILE_TERM,
 } task_file_flags_type_t;
 
+// Scheduling state of a task
+typedef enum {
+    TASK_RUNNABLE,
+    TASK_BLOCKED,
+} task_state_t;
+
 typedef struct {
     task_file_flags_type_t type;
     uint8_t used;
@@ -60,10 +66,35 @@ typedef struct PCB_s {
     int8_t signals;
     uint8_t pid;
     uint8_t term_ind;
-    // Total number of objects; unused objects are counted
-    uint32_t malloc_obj_count;
     sighandler_t *signal_handlers[SIG_SIZE];
+    // Address space of the task; loaded into cr3 when it is scheduled
+    PDE_t *page_dir;
+    // File backing the image pages, faulted in on first access
+    int32_t img_inode;
+    uint32_t img_size;
+    // rdtsc at execute; cleared by the first write
+    uint32_t exec_tsc;
+    // pid of the task that forked this one; 0 if started by execute.
+    // Nobody waits for a forked task, so halt just frees it
+    uint8_t fork_ppid;
+
+    // Scheduler bookkeeping; see scheduling.c
+    task_state_t state;
+    uint8_t priority;
+    uint8_t on_run_queue;
+    uint32_t slice_left;        // PIT clocks left in the time slice
+    uint32_t runnable_since;
+    uint8_t *sched_esp;
+    struct PCB_s *run_next;
+    struct PCB_s *run_prev;
+    struct PCB_s *wait_next;
 } PCB_t;
 
+// Tasks blocked on an event, linked through PCB_t.wait_next; see
+// sched_sleep_on and sched_wake_up
+typedef struct {
+    PCB_t *head;
+} wait_queue_t;
+
 
 #endif /* ifndef _TASK_H_ */
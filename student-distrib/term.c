@@ -3,13 +3,18 @@
 #include "lib.h"
 #include "syscall.h"
 #include "page.h"
+#include "scheduling.h"
 
 term_t terms[TERM_NUM];
 uint8_t cur_term_ind = 0;
+// Start of VGA text memory. Terminals never draw here; it holds the
+// scrollback view (term_scrollback)
 static uint8_t* video_mem = (uint8_t *)VIDEO;
 static uint8_t* back_1 = (uint8_t*)0xB9000;
 static uint8_t* back_2 = (uint8_t*)0xBA000;
 static uint8_t* back_3 = (uint8_t*)0xBB000;
+static uint16_t scrollback[TERM_NUM][TERM_SCROLLBACK_ROWS][NUM_COLS];
+static uint8_t out_rings[TERM_NUM][TERM_OUT_SIZE];
 
 int32_t term_read_invalid(int8_t* buf, uint32_t nbytes, FILE *file) {
     return -1;
@@ -36,6 +41,11 @@ file_ops_table_t stdout_file_ops_table = {
 
 void addch(uint8_t ch, term_t *cur_term);
 void delch(term_t *cur_term);
+static void hw_scroll_enter(term_t *cur_term);
+static void hw_scroll_leave(term_t *cur_term);
+static void scroll_screen(term_t *cur_term);
+static void vga_set_start(uint8_t *screen);
+static void term_drain(term_t *cur_term, uint32_t budget);
 
 // Dummy open and close functions
 int32_t term_open(const int8_t *filename, FILE *file) {
@@ -52,25 +62,25 @@ int32_t term_read(int8_t* buf, uint32_t nbytes, FILE *file) {
     }
     PCB_t *task_pcb = get_cur_pcb();
     term_t *cur_term = &terms[task_pcb->term_ind];
+    // Show the prompt before waiting for input
+    term_drain(cur_term, TERM_OUT_SIZE);
     if (cur_term->term_canon) {
+        cli();
         cur_term->reading = 1;
-        sti();
         while (!cur_term->term_buf_count) {
-            asm volatile ("hlt");
+            sched_sleep_on(&cur_term->read_wait);
         }
-        cli();
         cur_term->reading = 0;
         memcpy(buf, cur_term->term_buf, 1);
         cur_term->term_curpos = 1;
         delch(cur_term);
         return 1;
     } else {
+        cli();
         cur_term->reading = 1;
-        sti();
         while (!cur_term->term_read_done) {
-            asm volatile ("hlt");
+            sched_sleep_on(&cur_term->read_wait);
         }
-        cli();
         cur_term->reading = 0;
         if (!cur_term->term_noecho) {
             putc('\n', cur_term);
@@ -150,6 +160,8 @@ void esc_funcs(uint8_t f, uint8_t *args, uint8_t arg_len, term_t *cur_term) {
                             // Cursor scanline ends at 15; back to blocky cursor
                             outb(0x0B, 0x3D4); outb(0x0F, 0x3D5);
                         }
+                        break;
+                    case 4: term_set_hw_scroll(cur_term, setting); break;
                 }
             }
             break;
@@ -205,15 +217,205 @@ int8_t esc_parse(uint8_t c, term_t *cur_term) {
     return 1;
 }
 
+/* uint32_t term_blit(const uint8_t *s, uint32_t n, term_t *cur_term);
+ * Inputs: const uint8_t *s: bytes to draw
+ *         uint32_t n: number of bytes
+ *         term_t *cur_term: the terminal
+ * Return Value: number of bytes drawn
+ *  Function: Draw bytes straight into video memory a row at a time, wrapping
+ *  and scrolling as putc would, until an escape, '\r' or '\b'. The cursor
+ *  position is updated in the terminal but the VGA cursor is left alone */
+static uint32_t term_blit(const uint8_t *s, uint32_t n, term_t *cur_term) {
+    uint32_t flags, i = 0;
+    uint16_t attr = cur_term->attr << 8;
+    uint16_t *cell;
+    uint8_t c;
+    while (i < n) {
+        c = s[i];
+        if (c == 0x1b || c == '\r' || c == '\b') {
+            break;
+        }
+        cli_and_save(flags);
+        if (c == '\n') {
+            cur_term->cur_x = NUM_COLS;
+            i++;
+        } else {
+            // video_mem can move on a terminal switch or hardware scroll, so
+            // look it up again for every row
+            cell = (uint16_t *) cur_term->video_mem + cur_term->cur_y * NUM_COLS + cur_term->cur_x;
+            while (i < n && cur_term->cur_x < NUM_COLS) {
+                c = s[i];
+                if (c == 0x1b || c == '\r' || c == '\b' || c == '\n') {
+                    break;
+                }
+                *cell++ = attr | c;
+                cur_term->cur_x++;
+                i++;
+            }
+        }
+        if (cur_term->cur_x >= NUM_COLS) {
+            cur_term->cur_x = 0;
+            if (++cur_term->cur_y >= NUM_ROWS) {
+                scroll_screen(cur_term);
+                cur_term->cur_y = NUM_ROWS - 1;
+            }
+        }
+        restore_flags(flags);
+    }
+    return i;
+}
+
+/* void term_render(term_t *cur_term, const uint8_t *buf, uint32_t n);
+ * Inputs: term_t *cur_term: the terminal
+ *         const uint8_t *buf: output to draw
+ *         uint32_t n: number of bytes
+ * Return Value: void
+ *  Function: Draw output, leaving the VGA cursor for the caller. Plain text
+ *  goes to the screen in bulk; escapes and the characters that move the
+ *  cursor back go through esc_parse and putc */
+static void term_render(term_t *cur_term, const uint8_t *buf, uint32_t n) {
+    uint32_t i = 0;
+    while (i < n) {
+        if (cur_term->state == IDLE) {
+            i += term_blit(buf + i, n - i, cur_term);
+            if (i >= n) {
+                break;
+            }
+        }
+        uint8_t c = buf[i++];
+        if (esc_parse(c, cur_term)) {
+            putc(c, cur_term);
+        }
+    }
+}
+
+/* int32_t term_draw_begin(term_t *cur_term);
+ * Inputs: term_t *cur_term: the terminal
+ * Return Value: 1 if the caller may draw queued output, 0 if someone else is
+ *  drawing it
+ *  Function: Claim the terminal's output for drawing; term_draw_end releases
+ *  it */
+static int32_t term_draw_begin(term_t *cur_term) {
+    uint32_t flags;
+    int32_t claimed = 0;
+    cli_and_save(flags);
+    if (!cur_term->out_drawing) {
+        cur_term->out_drawing = 1;
+        claimed = 1;
+    }
+    restore_flags(flags);
+    return claimed;
+}
+
+static void term_draw_end(term_t *cur_term) {
+    setpos(cur_term->cur_x, cur_term->cur_y, cur_term);
+    cur_term->out_drawing = 0;
+}
+
+/* void term_drain(term_t *cur_term, uint32_t budget);
+ * Inputs: term_t *cur_term: the terminal
+ *         uint32_t budget: most bytes to draw
+ * Return Value: void
+ *  Function: Draw queued output in order, a contiguous part of the ring at a
+ *  time, and update the cursor once. Does nothing if the output is already
+ *  being drawn. Interrupts stay as they are; drawing only turns them off a
+ *  row at a time */
+static void term_drain(term_t *cur_term, uint32_t budget) {
+    uint32_t tail, n;
+    if (cur_term->out_head == cur_term->out_tail || !term_draw_begin(cur_term)) {
+        return;
+    }
+    while (budget && (tail = cur_term->out_tail) != cur_term->out_head) {
+        n = cur_term->out_head - tail;
+        if (n > TERM_OUT_SIZE - (tail & (TERM_OUT_SIZE - 1))) {
+            n = TERM_OUT_SIZE - (tail & (TERM_OUT_SIZE - 1));
+        }
+        if (n > budget) {
+            n = budget;
+        }
+        term_render(cur_term, cur_term->out_ring + (tail & (TERM_OUT_SIZE - 1)), n);
+        cur_term->out_tail = tail + n;
+        budget -= n;
+    }
+    term_draw_end(cur_term);
+}
+
+/* uint32_t term_enqueue(term_t *cur_term, const uint8_t *buf, uint32_t n);
+ * Inputs: term_t *cur_term: the terminal
+ *         const uint8_t *buf: output to queue
+ *         uint32_t n: number of bytes
+ * Return Value: number of bytes queued; less than `n' when the ring fills
+ *  Function: Copy output into the ring and publish it by moving out_head.
+ *  Syscalls run with interrupts off, so writers cannot interleave; the
+ *  cli_and_save only matters to kernel callers with them on. The drawing
+ *  side takes no lock */
+static uint32_t term_enqueue(term_t *cur_term, const uint8_t *buf, uint32_t n) {
+    uint32_t flags, head, off, first;
+    cli_and_save(flags);
+    head = cur_term->out_head;
+    if (n > TERM_OUT_SIZE - (head - cur_term->out_tail)) {
+        n = TERM_OUT_SIZE - (head - cur_term->out_tail);
+    }
+    off = head & (TERM_OUT_SIZE - 1);
+    first = n < TERM_OUT_SIZE - off ? n : TERM_OUT_SIZE - off;
+    memcpy(cur_term->out_ring + off, buf, first);
+    memcpy(cur_term->out_ring, buf + first, n - first);
+    cur_term->out_head = head + n;
+    restore_flags(flags);
+    return n;
+}
+
+/* void term_drain_foreground(void);
+ * Inputs: none
+ * Return Value: void
+ *  Function: Draw part of the output queued on the terminal on screen; the
+ *  PIT handler calls this on every tick */
+void term_drain_foreground(void) {
+    term_drain(&terms[cur_term_ind], TERM_DRAIN_BUDGET);
+}
+
+/* int32_t term_output_pending(void);
+ * Inputs: none
+ * Return Value: nonzero if the terminal on screen has output left to draw
+ *  Function: Lets the scheduler keep the timer running until it is drawn */
+int32_t term_output_pending(void) {
+    return terms[cur_term_ind].out_head != terms[cur_term_ind].out_tail;
+}
+
+/* int32_t term_write(const int8_t* buf, uint32_t nbytes, FILE *file);
+ * Inputs: const int8_t* buf: output
+ *         uint32_t nbytes: number of bytes
+ *         FILE *file: unused
+ * Return Value: nbytes
+ *  Function: Queue output for the writer's terminal. A terminal in the
+ *  background is only drawn when it is switched to or its queue is full;
+ *  the one on screen draws up to TERM_DRAIN_BUDGET bytes now and the rest on
+ *  the following timer ticks. Escape sequences also change how the terminal
+ *  reads, so writes with one are drawn before returning */
 int32_t term_write(const int8_t* buf, uint32_t nbytes, FILE *file) {
     PCB_t *task_pcb = get_cur_pcb();
+    uint32_t i;
     cur_term = &terms[task_pcb->term_ind];
-    int i;
-    for (i = 0; i < nbytes; i ++) {
-        uint8_t c = ((char * ) buf)[i];
-        if (esc_parse(c, cur_term)) {
-            putc(c, cur_term);
+    term_t *term = cur_term;
+
+    uint8_t escape = term->state != IDLE;
+
+    for (i = 0; i < nbytes && !escape; i++) {
+        escape = buf[i] == 0x1b;
+    }
+    i = 0;
+    while (1) {
+        i += term_enqueue(term, (uint8_t *) buf + i, nbytes - i);
+        if (i >= nbytes) {
+            break;
         }
+        // Full; make room by drawing it ourselves
+        term_drain(term, TERM_OUT_SIZE);
+    }
+    if (escape) {
+        term_drain(term, TERM_OUT_SIZE);
+    } else if (term == &terms[cur_term_ind]) {
+        term_drain(term, TERM_DRAIN_BUDGET);
     }
     return nbytes;
 }
@@ -223,26 +425,53 @@ void switch_term(uint8_t ind) {
         return;
     }
 
-    // Save old terminal
+    // Every terminal draws to its own VGA page, so switching only moves the
+    // CRTC start address and the cursor. Hardware scrolling is the exception;
+    // only the terminal on screen can use the scroll area
     cli();
-    memcpy(cur_term->video_buffer, video_mem, VID_MEM_SIZE);
-    cur_term->video_mem = cur_term->video_buffer;
+    cur_term = &terms[cur_term_ind];
+    if (cur_term->sb_view) {
+        term_scrollback(cur_term, -cur_term->sb_view);
+    }
+    if (cur_term->term_hw_scroll) {
+        hw_scroll_leave(cur_term);
+    }
 
-    // Put on new terminal
     cur_term_ind = ind;
     cur_term = &terms[ind];
-    cur_term->video_mem = video_mem;
-    setpos(cur_term->cur_x, cur_term->cur_y, cur_term);
-    memcpy(video_mem, cur_term->video_buffer, VID_MEM_SIZE);
+    if (cur_term->term_hw_scroll) {
+        hw_scroll_enter(cur_term);
+    } else {
+        vga_set_start(cur_term->video_mem);
+        setpos(cur_term->cur_x, cur_term->cur_y, cur_term);
+    }
     sti();
+    // Output queued while it was in the background is drawn like any other
+    // foreground output, a budget now and the rest on the next ticks
+    term_drain(cur_term, TERM_DRAIN_BUDGET);
+    pit_kick();
 }
 
 void term_key_handler(key_t key) {
     cur_term = &terms[cur_term_ind];
+    // Shift+PgUp/PgDn page through the scrollback; any other key brings the
+    // live screen back first
+    if (key.modifiers == MOD_SHIFT && (key.key == KEY_PGUP || key.key == KEY_PGDN)) {
+        term_scrollback(cur_term, key.key == KEY_PGUP ? NUM_ROWS - 1 : 1 - NUM_ROWS);
+        return;
+    }
+    if (cur_term->sb_view) {
+        term_scrollback(cur_term, -cur_term->sb_view);
+    }
+    // Echo after the output already written. Only a budget is drawn inside
+    // the interrupt; with more queued, the echo lands before the rest of it
+    term_drain(cur_term, TERM_DRAIN_BUDGET);
+    pit_kick();
     if (cur_term->term_canon
             && !(key.modifiers == MOD_ALT && key.key >= KEY_F1 && key.key <= KEY_F3)) {    // Canonical mode
         cur_term->term_curpos = cur_term->term_buf_count;
         addch(key.key, cur_term);
+        sched_wake_up(&cur_term->read_wait);
         return;
     }
 
@@ -318,14 +547,17 @@ void term_key_handler(key_t key) {
             case 'c':      // C-C; keyboard interrupt
                 puts("^C", cur_term);
                 uint8_t cur_pid = terms[cur_term_ind].cur_pid;
-                PCB_t *task_pcb = (PCB_t *) TASK_KSTACK_TOP(cur_pid);
-                task_pcb->signals |= SIG_FLAG(SIG_KB_INT);
+                PCB_t *task_pcb = task_pcbs[cur_pid];
+                if (task_pcb) {
+                    task_pcb->signals |= SIG_FLAG(SIG_KB_INT);
+                }
                 /* term_read_done = 1; */
                 /* term_buf_count = 0; */
                 return;
 
             case 'm':      // C-M / C-J; Return
                 cur_term->term_read_done = 1;
+                sched_wake_up(&cur_term->read_wait);
                 break;
         }
     } else if (key.modifiers == MOD_ALT) { // An alt'd character
@@ -441,10 +673,18 @@ void init_term() {
     terms[1].video_buffer = back_2;
     terms[2].video_buffer = back_3;
 
-    terms[0].video_mem = video_mem;
+    terms[0].video_mem = terms[0].video_buffer;
     terms[1].video_mem = terms[1].video_buffer;
     terms[2].video_mem = terms[2].video_buffer;
 
+    terms[0].sb_rows = scrollback[0];
+    terms[1].sb_rows = scrollback[1];
+    terms[2].sb_rows = scrollback[2];
+
+    terms[0].out_ring = out_rings[0];
+    terms[1].out_ring = out_rings[1];
+    terms[2].out_ring = out_rings[2];
+
     terms[0].attr = DEF_ATTR;
     terms[1].attr = DEF_ATTR;
     terms[2].attr = DEF_ATTR;
@@ -452,6 +692,8 @@ void init_term() {
     clear(&terms[0]);
     clear(&terms[1]);
     clear(&terms[2]);
+    vga_set_start(terms[0].video_mem);
+    setpos(0, 0, &terms[0]);
 
     sti();
 }
@@ -495,9 +737,11 @@ void setpos(int x, int y, term_t *cur_term) {
 	cur_term->cur_x = x;
 	cur_term->cur_y = y;
 
-	// Set VGA cursor position
+	// Set VGA cursor position; it counts from the start of VGA memory, not
+	// from the CRTC start address
     if (cur_term == &terms[cur_term_ind]) {
-        uint16_t curpos = cur_term->cur_x + cur_term->cur_y * NUM_COLS;
+        uint16_t curpos = ((cur_term->video_mem - video_mem) >> 1)
+            + cur_term->cur_x + cur_term->cur_y * NUM_COLS;
         outb(0x0F, 0x3D4);
         outb(curpos & 0xFF, 0x3D5);
         outb(0x0E, 0x3D4);
@@ -681,7 +925,161 @@ void set_vid_char(int x, int y, uint8_t ch, term_t *cur_term) {
 	cur_term->video_mem[((NUM_COLS * y + x) << 1) + 1] = cur_term->attr;
 }
 
+/* void vga_set_start(uint8_t *screen);
+ * Inputs: uint8_t *screen: VGA memory to display from
+ * Return Value: void
+ *  Function: Point the CRTC start address at `screen' */
+static void vga_set_start(uint8_t *screen) {
+	uint16_t start = (screen - video_mem) >> 1;
+	outb(VGA_CRTC_START_HI, VGA_CRTC_ADDR);
+	outb(start >> 8, VGA_CRTC_DATA);
+	outb(VGA_CRTC_START_LO, VGA_CRTC_ADDR);
+	outb(start & 0xFF, VGA_CRTC_DATA);
+}
+
+/* void hw_scroll_enter(term_t *cur_term);
+ * Inputs: term_t *cur_term: the terminal on screen
+ * Return Value: void
+ *  Function: Move the screen to the start of the scroll area and display
+ *  it from there */
+static void hw_scroll_enter(term_t *cur_term) {
+	uint8_t *area = (uint8_t *) VGA_SCROLL_BASE;
+	memcpy(area, cur_term->video_mem, VID_MEM_SIZE);
+	cur_term->video_mem = area;
+	vga_set_start(area);
+	setpos(cur_term->cur_x, cur_term->cur_y, cur_term);
+}
+
+/* void hw_scroll_leave(term_t *cur_term);
+ * Inputs: term_t *cur_term: the terminal on screen
+ * Return Value: void
+ *  Function: Move the screen back to the terminal's own page */
+static void hw_scroll_leave(term_t *cur_term) {
+	memcpy(cur_term->video_buffer, cur_term->video_mem, VID_MEM_SIZE);
+	cur_term->video_mem = cur_term->video_buffer;
+	vga_set_start(cur_term->video_mem);
+	setpos(cur_term->cur_x, cur_term->cur_y, cur_term);
+}
+
+/* void term_set_hw_scroll(term_t *cur_term, uint8_t on);
+ * Inputs: term_t *cur_term: the terminal
+ *         uint8_t on: whether to scroll with the CRTC start address
+ * Return Value: void
+ *  Function: Switch a terminal's scroll mode. Only the terminal on screen
+ *  uses the scroll area; the others switch when they are brought up */
+void term_set_hw_scroll(term_t *cur_term, uint8_t on) {
+	uint32_t flags;
+	cli_and_save(flags);
+	if (cur_term == &terms[cur_term_ind] && on != cur_term->term_hw_scroll) {
+		term_scrollback(cur_term, -cur_term->sb_view);
+		if (on) {
+			hw_scroll_enter(cur_term);
+		} else {
+			hw_scroll_leave(cur_term);
+		}
+	}
+	cur_term->term_hw_scroll = on;
+	restore_flags(flags);
+}
+
+/* void term_scrollback(term_t *cur_term, int32_t rows);
+ * Inputs: term_t *cur_term: the terminal on screen
+ *         int32_t rows: rows to move back into the scrollback; negative
+ *         moves towards live output
+ * Return Value: void
+ *  Function: Show the screen `rows' further back. The view is drawn into
+ *  the page at the start of VGA memory, which no terminal uses, and shown
+ *  with the CRTC start address, so the program keeps writing to its own
+ *  screen underneath */
+void term_scrollback(term_t *cur_term, int32_t rows) {
+	uint32_t flags;
+	int32_t view = cur_term->sb_view + rows;
+	int32_t r, back;
+	uint16_t *src, *dst = (uint16_t *) video_mem;
+	if (cur_term != &terms[cur_term_ind]) {
+		return;
+	}
+	if (view < 0) {
+		view = 0;
+	} else if (view > cur_term->sb_count) {
+		view = cur_term->sb_count;
+	}
+
+	cli_and_save(flags);
+	cur_term->sb_view = view;
+	if (!view) {
+		vga_set_start(cur_term->video_mem);
+		restore_flags(flags);
+		return;
+	}
+	for (r = 0; r < NUM_ROWS; r++) {
+		back = view - r;
+		if (back > 0) {
+			src = cur_term->sb_rows[(cur_term->sb_head + TERM_SCROLLBACK_ROWS - back) % TERM_SCROLLBACK_ROWS];
+		} else {
+			src = (uint16_t *) cur_term->video_mem + (r - view) * NUM_COLS;
+		}
+		memcpy(dst + r * NUM_COLS, src, VID_ROW_SIZE);
+	}
+	vga_set_start(video_mem);
+	restore_flags(flags);
+}
+
+/* void scroll_screen(term_t *cur_term);
+ * Inputs: term_t *cur_term: the terminal
+ * Return Value: void
+ *  Function: Move the screen up one row and clear the bottom row, leaving
+ *  the cursor alone; call with interrupts off. The row going off the top is
+ *  added to the scrollback. With hardware scrolling the screen instead
+ *  slides one row further into the scroll area, and is copied back to its
+ *  start once it reaches the end */
+static void scroll_screen(term_t *cur_term) {
+	uint8_t *screen = cur_term->video_mem;
+	memcpy(cur_term->sb_rows[cur_term->sb_head], screen, VID_ROW_SIZE);
+	cur_term->sb_head = (cur_term->sb_head + 1) % TERM_SCROLLBACK_ROWS;
+	if (cur_term->sb_count < TERM_SCROLLBACK_ROWS) {
+		cur_term->sb_count++;
+	}
+	// Keep a history view on the same rows as output comes in under it
+	if (cur_term->sb_view && cur_term->sb_view < cur_term->sb_count) {
+		cur_term->sb_view++;
+	}
+	if (screen >= (uint8_t *) VGA_SCROLL_BASE) {
+		if (screen + VID_ROW_SIZE + VID_MEM_SIZE <= (uint8_t *) VGA_SCROLL_BASE + VGA_SCROLL_SIZE) {
+			screen += VID_ROW_SIZE;
+		} else {
+			memmove((uint8_t *) VGA_SCROLL_BASE, screen + VID_ROW_SIZE, VID_MEM_SIZE - VID_ROW_SIZE);
+			screen = (uint8_t *) VGA_SCROLL_BASE;
+		}
+		cur_term->video_mem = screen;
+		if (!cur_term->sb_view) {
+			vga_set_start(screen);
+		}
+	} else {
+		memmove(screen, screen + VID_ROW_SIZE, VID_MEM_SIZE - VID_ROW_SIZE);
+	}
+	memset_word(screen + VID_MEM_SIZE - VID_ROW_SIZE, DEF_ATTR << 8 | ' ', NUM_COLS);
+}
+
+/* void scroll(term_t *cur_term);
+ * Inputs: term_t *cur_term: the terminal
+ * Return Value: void
+ *  Function: Scroll the screen up one row and move the cursor up with the
+ *  text */
 void scroll(term_t *cur_term) {
+	uint32_t flags;
+	cli_and_save(flags);
+	scroll_screen(cur_term);
+	setpos(cur_term->cur_x, cur_term->cur_y - 1, cur_term);
+	restore_flags(flags);
+}
+
+/* void scroll_charwise(term_t *cur_term);
+ * Inputs: term_t *cur_term: the terminal
+ * Return Value: void
+ *  Function: Reference character at a time scroll that scroll() replaced;
+ *  only kept so tests.c can compare the two */
+void scroll_charwise(term_t *cur_term) {
 	cli();
 	int x, y;
 	uint8_t old_attr = cur_term->attr;
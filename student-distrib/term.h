@@ -2,6 +2,7 @@
 #define _TERM_H_
 
 #include "types.h"
+#include "lib.h"
 #include "kb.h"
 #include "task.h"
 
@@ -10,6 +11,21 @@
 #define TERM_BUF_SIZE_W_NL 128
 
 #define VID_MEM_SIZE (2 * 80 * 25)
+#define VID_ROW_SIZE (2 * 80)
+// Hardware scrolling slides the visible screen through the VGA memory past
+// the terminal pages by moving the CRTC start address; see scroll_screen() in term.c
+#define VGA_SCROLL_BASE (VGA_SCROLL_BEG << 12)
+#define VGA_SCROLL_SIZE ((VGA_SCROLL_END - VGA_SCROLL_BEG) << 12)
+#define VGA_CRTC_ADDR 0x3D4
+#define VGA_CRTC_DATA 0x3D5
+#define VGA_CRTC_START_HI 0x0C
+#define VGA_CRTC_START_LO 0x0D
+// Rows of scrolled off output kept per terminal; Shift+PgUp/PgDn views them
+#define TERM_SCROLLBACK_ROWS 256
+// Bytes of output queued per terminal; a power of two
+#define TERM_OUT_SIZE 8192
+// Most queued bytes the terminal on screen draws per write or timer tick
+#define TERM_DRAIN_BUDGET 2048
 
 typedef enum {
     IDLE,
@@ -28,13 +44,32 @@ typedef struct {
     int8_t cur_x_store, cur_y_store;
     uint8_t attr;
     uint8_t reading;
+    // The task blocked in term_read, woken by term_key_handler
+    wait_queue_t read_wait;
 
+    // Where the terminal draws: its own VGA page, or the scroll area while
+    // it is on screen with hardware scrolling
     uint8_t *video_mem;
     uint8_t* video_buffer;
     uint8_t term_noecho : 1;
     uint8_t term_canon : 1;
+    // Scroll with the CRTC start address while on screen; set with ESC[s4.
+    // Leave it off in programs that draw through vidmap
+    uint8_t term_hw_scroll : 1;
     uint8_t cur_pid;
 
+    // Ring of rows scrolled off the top, oldest first from sb_head - sb_count.
+    // sb_view is how many rows back the screen is showing; 0 is live output
+    uint16_t (*sb_rows)[NUM_COLS];
+    uint16_t sb_head, sb_count, sb_view;
+
+    // Output term_write has queued but not drawn. Writers add at out_head
+    // and the drawing side takes from out_tail; out_drawing is set while
+    // someone draws so interrupt handlers leave the terminal alone
+    uint8_t *out_ring;
+    volatile uint32_t out_head, out_tail;
+    volatile uint8_t out_drawing;
+
     esc_state_t state;
     // Buffer for each argument
     int8_t buf[4];
@@ -50,6 +85,7 @@ uint8_t cur_term_ind;
 term_t *cur_term;
 
 void term_key_handler(key_t key);
+void switch_term(uint8_t ind);
 void init_term();
 int32_t term_write(const int8_t* buf, uint32_t nbytes, FILE *file);
 int32_t term_read(int8_t* buf, uint32_t nbytes, FILE *file);
@@ -60,6 +96,11 @@ int32_t printf(term_t *cur_term, int8_t *format, ...);
 void putc(uint8_t c, term_t *cur_term);
 int32_t puts(int8_t *s, term_t *cur_term);
 void scroll(term_t *cur_term);
+void scroll_charwise(term_t *cur_term);
+void term_set_hw_scroll(term_t *cur_term, uint8_t on);
+void term_scrollback(term_t *cur_term, int32_t rows);
+void term_drain_foreground(void);
+int32_t term_output_pending(void);
 void clear(term_t *cur_term);
 void setpos(int x, int y, term_t *cur_term);
 void setattr(uint8_t _attr, term_t *cur_term);
@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 4
+#define WINDOW (1 << 30)
+// Two rdtsc reads further apart than this mean the CPU was taken away
+#define GAP 2000
+
+/*
+ * Measures how much of the CPU a compute-bound task gets. It spins on rdtsc
+ * for a fixed window and counts every gap between two reads as time spent
+ * elsewhere (other tasks, interrupt handlers). Run it on one terminal while
+ * the other two sit at a shell prompt. An argument sets its priority, so
+ * two copies on different terminals show how priorities split the CPU.
+ */
+int main ()
+{
+    uint32_t i, start, prev, now, stolen, share;
+    uint8_t arg[8];
+
+    if (0 == ece391_getargs (arg, sizeof (arg)) && '\0' != arg[0]
+            && 0 != ece391_set_priority (arg[0] - '0')) {
+        ece391_fdputs (1, (uint8_t*)"priority must be 1 to 8\n");
+        return 3;
+    }
+
+    for (i = 0; i < ROUNDS; i++) {
+        stolen = 0;
+        start = prev = ece391_rdtsc ();
+        do {
+            now = ece391_rdtsc ();
+            if (now - prev > GAP)
+                stolen += now - prev;
+            prev = now;
+        } while (now - start < WINDOW);
+
+        share = (now - start - stolen) / ((now - start) / 100);
+        ece391_putnum ("cpu available: ", share, "%");
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define ROUNDS 32
+
+/*
+ * Measures the execute -> halt round trip the shell pays for every command.
+ * Usage: exectest [command]; defaults to "testprint", which exits right
+ * away without waiting on the keyboard like "hello" does.
+ */
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    uint32_t i, start, total = 0, best = 0xFFFFFFFF;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE))
+        ece391_strcpy (cmd, (uint8_t*)"testprint");
+
+    for (i = 0; i < ROUNDS; i++) {
+        start = ece391_rdtsc ();
+        if (-1 == ece391_execute (cmd)) {
+            ece391_fdputs (1, (uint8_t*)"no such command\n");
+            return 3;
+        }
+        start = ece391_rdtsc () - start;
+        total += start;
+        if (start < best)
+            best = start;
+    }
+
+    ece391_putnum ("execute+halt average: ", total / ROUNDS, " cycles");
+    ece391_putnum ("execute+halt best:    ", best, " cycles");
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define ROUNDS 32
+#define FORK_EXEC_ROUNDS 4
+#define RTC_RATE 16
+
+/*
+ * Compares starting a program with plain execute against fork followed by
+ * execute in the child. Usage: forkbench [command]; defaults to
+ * "testprint". Nothing waits for a forked child, so the parent sleeps on
+ * the RTC between rounds and each fork+exec child reports its own time,
+ * measured from just before the fork to the return of its execute.
+ */
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    uint32_t i, start, total, garbage;
+    int32_t rtc_fd, rate = RTC_RATE, pid;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE))
+        ece391_strcpy (cmd, (uint8_t*)"testprint");
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    if (-1 == rtc_fd || -1 == ece391_write (rtc_fd, &rate, 4)) {
+        ece391_fdputs (1, (uint8_t*)"cannot set up the rtc\n");
+        return 3;
+    }
+
+    for (i = 0, total = 0; i < ROUNDS; i++) {
+        start = ece391_rdtsc ();
+        if (-1 == ece391_execute (cmd)) {
+            ece391_fdputs (1, (uint8_t*)"no such command\n");
+            return 3;
+        }
+        total += ece391_rdtsc () - start;
+    }
+    ece391_putnum ("execute+halt average:      ", total / ROUNDS, " cycles");
+
+    /* The cost of fork alone, as seen by the parent */
+    for (i = 0, total = 0; i < ROUNDS; i++) {
+        start = ece391_rdtsc ();
+        pid = ece391_fork ();
+        if (0 == pid)
+            ece391_halt (0);
+        total += ece391_rdtsc () - start;
+        if (-1 == pid) {
+            ece391_fdputs (1, (uint8_t*)"fork failed\n");
+            return 3;
+        }
+        ece391_read (rtc_fd, &garbage, 4);
+    }
+    ece391_putnum ("fork average:              ", total / ROUNDS, " cycles");
+
+    for (i = 0; i < FORK_EXEC_ROUNDS; i++) {
+        start = ece391_rdtsc ();
+        pid = ece391_fork ();
+        if (0 == pid) {
+            ece391_execute (cmd);
+            ece391_putnum ("fork+execute+halt:         ", ece391_rdtsc () - start, " cycles");
+            ece391_halt (0);
+        }
+        ece391_read (rtc_fd, &garbage, 4);
+        ece391_read (rtc_fd, &garbage, 4);
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 100
+#define BUFSIZE 1024
+
+/*
+ * Compares the two ways grep can look at a file: read copying it into a
+ * buffer BUFSIZE bytes at a time, and scanning it in place after one mmap.
+ * Both count the lines of the largest file in the image every round; the
+ * read side reopens the file to start over, the mapped side maps it once.
+ */
+int main ()
+{
+    uint8_t name[] = "fish";
+    uint8_t buf[BUFSIZE];
+    uint8_t* data;
+    uint32_t round, start, copied, mapped, lines_read, lines_map;
+    int32_t fd, i, cnt, len;
+
+    if (-1 == (fd = ece391_open (name))) {
+        ece391_fdputs (1, (uint8_t*)"cannot open fish\n");
+        return 3;
+    }
+
+    lines_read = 0;
+    len = 0;
+    start = ece391_rdtsc ();
+    for (round = 0; round < ROUNDS; round++) {
+        ece391_close (fd);
+        ece391_open (name);
+        while (0 < (cnt = ece391_read (fd, buf, BUFSIZE))) {
+            for (i = 0; i < cnt; i++)
+                lines_read += '\n' == buf[i];
+            len += cnt;
+        }
+    }
+    copied = ece391_rdtsc () - start;
+
+    lines_map = 0;
+    start = ece391_rdtsc ();
+    if (0 >= (cnt = ece391_mmap (fd, &data))) {
+        ece391_fdputs (1, (uint8_t*)"mmap failed\n");
+        return 3;
+    }
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < cnt; i++)
+            lines_map += '\n' == data[i];
+    }
+    mapped = ece391_rdtsc () - start;
+    ece391_close (fd);
+
+    if (lines_read != lines_map || len != cnt * ROUNDS) {
+        ece391_fdputs (1, (uint8_t*)"the two runs saw different data\n");
+        return 3;
+    }
+    ece391_putnum ("read into a buffer:  ", copied / (len / 1024), " cycles/KB");
+    ece391_putnum ("scan the mapping:    ", mapped / (len / 1024), " cycles/KB");
+    return 0;
+}
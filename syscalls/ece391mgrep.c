@@ -0,0 +1,91 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+
+/*
+ * grep over mmap: each file is mapped once and its lines are searched and
+ * written straight from the mapping, without read copying them into a
+ * buffer first. Lines are not NUL terminated here, so every compare is
+ * bounded by the line end.
+ */
+int32_t
+do_one_file (const char* s, const char* fname)
+{
+    int32_t fd, len, line_start, line_end, check, s_len;
+    uint8_t* data;
+    ece391_iovec_t out[4];
+
+    s_len = ece391_strlen ((uint8_t*)s);
+    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+        ece391_fdputs (1, (uint8_t*)"file open failed\n");
+        return -1;
+    }
+    if (-1 == (len = ece391_mmap (fd, &data))) {
+        ece391_fdputs (1, (uint8_t*)"file map failed\n");
+        ece391_close (fd);
+        return -1;
+    }
+    for (line_start = 0; line_start < len; line_start = line_end + 1) {
+	line_end = line_start;
+	while (line_end < len && '\n' != data[line_end])
+	    line_end++;
+	for (check = line_start; check + s_len <= line_end; check++) {
+	    if (s[0] == data[check] &&
+		0 == ece391_strncmp (data + check, (uint8_t*)s, s_len)) {
+		out[0].base = (void*)fname;
+		out[0].len = ece391_strlen ((uint8_t*)fname);
+		out[1].base = ":";
+		out[1].len = 1;
+		out[2].base = data + line_start;
+		out[2].len = line_end - line_start;
+		out[3].base = "\n";
+		out[3].len = 1;
+		ece391_writev (1, out, 4);
+		break;
+	    }
+	}
+    }
+    if (-1 == ece391_close (fd)) {
+        ece391_fdputs (1, (uint8_t*)"file close failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+int main ()
+{
+    int32_t fd, cnt;
+    uint8_t buf[SBUFSIZE];
+    uint8_t search[BUFSIZE];
+
+    if (0 != ece391_getargs (search, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"could not read argument\n");
+        return 3;
+    }
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+        ece391_fdputs (1, (uint8_t*)"directory open failed\n");
+	return 2;
+    }
+
+    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+        if (-1 == cnt) {
+	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
+	    return 3;
+	}
+	if ('.' == buf[0]) /* a directory... */
+	    continue;
+	buf[cnt] = '\0';
+	/* the rtc is not a regular file and cannot be mapped */
+	if (0 == ece391_strcmp (buf, (uint8_t*)"rtc"))
+	    continue;
+	if (0 != do_one_file ((char*)search, (char*)buf))
+	    return 3;
+    }
+
+    return 0;
+}
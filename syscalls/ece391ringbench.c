@@ -0,0 +1,75 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 1000
+#define BATCH 16
+#define CHUNK 32
+
+/*
+ * Compares small reads done one syscall at a time with the same reads
+ * queued on the syscall ring and run by one ring_enter per batch. Each
+ * round closes and reopens the file to start over from its beginning,
+ * then reads it CHUNK bytes at a time. open hands out the lowest free
+ * descriptor, so the reopened file keeps its number and the reads can be
+ * queued behind the open.
+ */
+int main ()
+{
+    uint8_t name[] = "frame0.txt";
+    uint8_t buf[BATCH][CHUNK];
+    ece391_ring_t* ring;
+    uint32_t round, i, start, direct, ringed, bytes_direct, bytes_ring;
+    int32_t fd;
+
+    if (-1 == (fd = ece391_open (name))) {
+        ece391_fdputs (1, (uint8_t*)"cannot open frame0.txt\n");
+        return 3;
+    }
+
+    bytes_direct = 0;
+    start = ece391_rdtsc ();
+    for (round = 0; round < ROUNDS; round++) {
+        ece391_close (fd);
+        ece391_open (name);
+        for (i = 2; i < BATCH; i++)
+            bytes_direct += ece391_read (fd, buf[i], CHUNK);
+    }
+    direct = ece391_rdtsc () - start;
+
+    ring = ece391_ring_setup ();
+    bytes_ring = 0;
+    start = ece391_rdtsc ();
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < BATCH; i++) {
+            ece391_sqe_t* sqe = &ring->sq[ring->sq_tail % RING_ENTRIES];
+            sqe->op = 0 == i ? RING_OP_CLOSE : 1 == i ? RING_OP_OPEN : RING_OP_READ;
+            sqe->fd = fd;
+            sqe->buf = 1 == i ? (void*)name : (void*)buf[i];
+            sqe->len = CHUNK;
+            sqe->user_data = i;
+            ring->sq_tail++;
+        }
+        if (BATCH != ece391_ring_enter (BATCH)) {
+            ece391_fdputs (1, (uint8_t*)"ring_enter failed\n");
+            return 3;
+        }
+        while (ring->cq_head != ring->cq_tail) {
+            ece391_cqe_t* cqe = &ring->cq[ring->cq_head % RING_ENTRIES];
+            if (cqe->user_data >= 2 && cqe->res > 0)
+                bytes_ring += cqe->res;
+            ring->cq_head++;
+        }
+    }
+    ringed = ece391_rdtsc () - start;
+    ece391_close (fd);
+
+    if (bytes_direct != bytes_ring) {
+        ece391_fdputs (1, (uint8_t*)"the two runs read different data\n");
+        return 3;
+    }
+    ece391_putnum ("one syscall per op:  ", direct / (ROUNDS * BATCH), " cycles/op");
+    ece391_putnum ("ring, 16 ops/enter:  ", ringed / (ROUNDS * BATCH), " cycles/op");
+    return 0;
+}
@@ -118,3 +118,99 @@ char *ece391_strdup(const char *str) {
     new_str[len] = 0;
     return new_str;
 }
+
+/*
+ * User-space small object allocator. Objects of up to UMALLOC_MAX_SIZE
+ * bytes are carved locally out of arenas, with one free list per
+ * power-of-two size class. Allocating or freeing them needs no syscall.
+ * A new arena is taken from the kernel heap with ece391_malloc only when
+ * the current one runs out. Larger objects go straight to the kernel.
+ * Every object has an 8-byte header holding its size class, so
+ * ece391_ufree knows where to send it. Arena memory is never handed back
+ * to the kernel.
+ */
+#define UMALLOC_ARENA_SIZE (16 * 1024)
+#define UMALLOC_MIN_SHIFT 4
+#define UMALLOC_CLASS_NUM 8
+#define UMALLOC_HDR_SIZE 8
+#define UMALLOC_MAX_SIZE ((1 << (UMALLOC_MIN_SHIFT + UMALLOC_CLASS_NUM - 1)) - UMALLOC_HDR_SIZE)
+#define UMALLOC_LARGE 0xFF
+
+typedef struct umalloc_obj {
+    uint32_t cls;
+    uint32_t pad;
+    struct umalloc_obj *next;   /* Only valid while on a free list */
+} umalloc_obj_t;
+
+static umalloc_obj_t *umalloc_free_lists[UMALLOC_CLASS_NUM];
+static uint8_t *umalloc_arena_cur;
+static uint8_t *umalloc_arena_end;
+
+void *ece391_umalloc(uint32_t bytes) {
+    uint32_t cls, cls_size;
+    umalloc_obj_t *obj;
+
+    if (bytes > UMALLOC_MAX_SIZE) {
+        /* The header must not wrap the size around to a tiny block */
+        if (bytes > UINT32_MAX - UMALLOC_HDR_SIZE)
+            return 0;
+        obj = ece391_malloc(bytes + UMALLOC_HDR_SIZE);
+        if (!obj)
+            return 0;
+        obj->cls = UMALLOC_LARGE;
+        return (uint8_t *) obj + UMALLOC_HDR_SIZE;
+    }
+
+    for (cls = 0; (1U << (cls + UMALLOC_MIN_SHIFT)) < bytes + UMALLOC_HDR_SIZE; cls++);
+    cls_size = 1U << (cls + UMALLOC_MIN_SHIFT);
+
+    if ((obj = umalloc_free_lists[cls])) {
+        umalloc_free_lists[cls] = obj->next;
+        return (uint8_t *) obj + UMALLOC_HDR_SIZE;
+    }
+
+    if (umalloc_arena_end - umalloc_arena_cur < cls_size) {
+        /* The tail of the old arena is abandoned; it is smaller than one
+         * object of this class anyway */
+        uint8_t *arena = ece391_malloc(UMALLOC_ARENA_SIZE);
+        if (!arena)
+            return 0;
+        umalloc_arena_cur = arena;
+        umalloc_arena_end = arena + UMALLOC_ARENA_SIZE;
+    }
+
+    obj = (umalloc_obj_t *) umalloc_arena_cur;
+    umalloc_arena_cur += cls_size;
+    obj->cls = cls;
+    return (uint8_t *) obj + UMALLOC_HDR_SIZE;
+}
+
+void ece391_ufree(void *ptr) {
+    umalloc_obj_t *obj;
+
+    if (!ptr)
+        return;
+    obj = (umalloc_obj_t *) ((uint8_t *) ptr - UMALLOC_HDR_SIZE);
+    if (obj->cls == UMALLOC_LARGE) {
+        ece391_free(obj);
+        return;
+    }
+    obj->next = umalloc_free_lists[obj->cls];
+    umalloc_free_lists[obj->cls] = obj;
+}
+
+/* Low 32 bits of the time stamp counter; enough for timing short loops */
+uint32_t ece391_rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+/* Print "<label><value><unit>\n" to stdout; used by the benchmarks */
+void ece391_putnum(const char *label, uint32_t value, const char *unit) {
+    uint8_t buf[16];
+    ece391_fdputs(1, (const uint8_t *) label);
+    ece391_fdputs(1, ece391_itoa(value, buf, 10));
+    ece391_fdputs(1, (const uint8_t *) unit);
+    ece391_fdputs(1, (const uint8_t *) "\n");
+}
@@ -10,6 +10,10 @@ extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 extern void *ece391_calloc(uint32_t bytes);
 extern char *ece391_strdup(const char *str);
+extern void *ece391_umalloc(uint32_t bytes);
+extern void ece391_ufree(void *ptr);
+extern uint32_t ece391_rdtsc(void);
+extern void ece391_putnum(const char *label, uint32_t value, const char *unit);
 
 #endif /* ECE391SUPPORT_H */
 
@@ -23,6 +23,76 @@ extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 extern void *ece391_malloc(uint32_t);
 extern int32_t ece391_free(void *);
+/* Returns the child's pid in the parent and 0 in the child. */
+extern int32_t ece391_fork (void);
+
+/* One buffer for readv and writev, which take up to 64 of them and return
+ * the total bytes moved, stopping after a short read or write. */
+typedef struct {
+    void* base;
+    uint32_t len;
+} ece391_iovec_t;
+extern int32_t ece391_readv (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+
+/*
+ * Batched system calls. ring_setup returns the task's ring, empty. Fill
+ * sq[sq_tail % RING_ENTRIES] and bump sq_tail for each operation, then
+ * ring_enter runs up to to_submit of them in order and returns how many
+ * it ran. Each leaves a completion at cq[cq_head % RING_ENTRIES] with the
+ * return value read, write, open or close would have given; bump cq_head
+ * once it has been looked at. buf is the file name for RING_OP_OPEN.
+ */
+#define RING_ENTRIES 64
+enum ring_ops {
+	RING_OP_READ = 0,
+	RING_OP_WRITE,
+	RING_OP_OPEN,
+	RING_OP_CLOSE
+};
+typedef struct {
+    uint32_t op;
+    int32_t fd;
+    void* buf;
+    uint32_t len;
+    uint32_t user_data;
+} ece391_sqe_t;
+typedef struct {
+    uint32_t user_data;
+    int32_t res;
+} ece391_cqe_t;
+typedef struct {
+    volatile uint32_t sq_head, sq_tail;
+    volatile uint32_t cq_head, cq_tail;
+    ece391_sqe_t sq[RING_ENTRIES];
+    ece391_cqe_t cq[RING_ENTRIES];
+} ece391_ring_t;
+extern ece391_ring_t* ece391_ring_setup (void);
+extern int32_t ece391_ring_enter (uint32_t to_submit);
+
+/* Maps an open regular file read-only and returns its length, with the
+ * address of its first byte in *start. The pages are the file system's
+ * own blocks, so writing to them is a segfault. Mappings last until the
+ * program halts. */
+extern int32_t ece391_mmap (int32_t fd, uint8_t** start);
+
+/* Random access to regular files. lseek moves the position and returns
+ * it; pread reads at offset and leaves the position alone. */
+enum seek_whence {
+	SEEK_SET = 0,
+	SEEK_CUR,
+	SEEK_END
+};
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, uint32_t nbytes, uint32_t offset);
+
+/* Sets how many scheduler quanta the program runs per time slice, 1 to 8;
+ * every task starts at 1. */
+extern int32_t ece391_set_priority (int32_t priority);
+
+/* Set by _start when the calls can go through sysenter; clear it to go
+ * back to INT $0x80. */
+extern uint8_t ece391_use_sysenter;
 
 enum signums {
 	DIV_ZERO = 0,
@@ -0,0 +1,45 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define CALLS 100000
+#define RTC_RATE 2
+
+/*
+ * Measures null system call round trips, a close of an invalid fd, once
+ * through INT $0x80 and once through sysenter if the CPU has it. Cycles
+ * per second come from timing one period of the RTC at 2 Hz.
+ */
+int main ()
+{
+    uint32_t i, start, per_sec, cycles, garbage;
+    int32_t rtc_fd, rate = RTC_RATE;
+    uint8_t has_sysenter = ece391_use_sysenter;
+    uint8_t mode;
+
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    if (-1 == rtc_fd || -1 == ece391_write (rtc_fd, &rate, 4)) {
+        ece391_fdputs (1, (uint8_t*)"cannot set up the rtc\n");
+        return 3;
+    }
+    ece391_read (rtc_fd, &garbage, 4);
+    start = ece391_rdtsc ();
+    ece391_read (rtc_fd, &garbage, 4);
+    per_sec = (ece391_rdtsc () - start) * RTC_RATE;
+
+    for (mode = 0; mode <= has_sysenter; mode++) {
+        ece391_use_sysenter = mode;
+        start = ece391_rdtsc ();
+        for (i = 0; i < CALLS; i++)
+            ece391_close (-1);
+        cycles = (ece391_rdtsc () - start) / CALLS;
+        ece391_fdputs (1, mode ? (uint8_t*)"sysenter:\n" : (uint8_t*)"int $0x80:\n");
+        ece391_putnum ("  round trip:     ", cycles, " cycles");
+        ece391_putnum ("  round trips/s:  ", per_sec / (cycles ? cycles : 1), "");
+    }
+    ece391_use_sysenter = has_sysenter;
+    if (!has_sysenter)
+        ece391_fdputs (1, (uint8_t*)"no sysenter on this CPU\n");
+    return 0;
+}
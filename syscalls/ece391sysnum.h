@@ -13,5 +13,14 @@
 #define SYS_SIGRETURN  10
 #define SYS_MALLOC  11
 #define SYS_FREE  12
+#define SYS_FORK  13
+#define SYS_READV  14
+#define SYS_WRITEV  15
+#define SYS_RING_SETUP  16
+#define SYS_RING_ENTER  17
+#define SYS_MMAP  18
+#define SYS_LSEEK  19
+#define SYS_PREAD  20
+#define SYS_SET_PRIORITY  21
 
 #endif /* ECE391SYSNUM_H */
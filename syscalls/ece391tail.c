@@ -0,0 +1,51 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define LINES 10
+
+/*
+ * Prints the last LINES lines of a file, or as many of them as fit in the
+ * last BUFSIZE bytes. lseek finds the length and pread fetches the end
+ * directly, so the rest of the file is never read.
+ */
+int main ()
+{
+    int32_t fd, size, cnt, start, lines;
+    uint8_t buf[BUFSIZE];
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
+	return 3;
+    }
+
+    if (-1 == (fd = ece391_open (buf))) {
+        ece391_fdputs (1, (uint8_t*)"file not found\n");
+	return 2;
+    }
+
+    if (-1 == (size = ece391_lseek (fd, 0, SEEK_END))) {
+        ece391_fdputs (1, (uint8_t*)"not a regular file\n");
+	return 3;
+    }
+    start = size > BUFSIZE ? size - BUFSIZE : 0;
+    if (-1 == (cnt = ece391_pread (fd, buf, BUFSIZE, start))) {
+        ece391_fdputs (1, (uint8_t*)"file read failed\n");
+	return 3;
+    }
+    if (0 == cnt)
+	return 0;
+
+    /* walk back over LINES line ends, not counting one that ends the file */
+    lines = 0;
+    for (start = cnt - 1; start > 0; start--) {
+	if ('\n' == buf[start - 1] && LINES == ++lines)
+	    break;
+    }
+    if (-1 == ece391_write (1, buf + start, cnt - start))
+	return 3;
+
+    return 0;
+}
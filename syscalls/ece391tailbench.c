@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 1000
+#define TAIL 100
+#define BUFSIZE 1024
+
+/*
+ * Times three ways to read the last TAIL bytes of the large text file:
+ * reopening it and reading up to the end as before, seeking to the end
+ * with lseek and reading, and one pread at the offset.
+ */
+int main ()
+{
+    uint8_t name[] = "verylargetextwithverylongname.txt";
+    uint8_t buf[BUFSIZE];
+    uint8_t tail[3][TAIL];
+    uint32_t round, start, reread, seeked, preaded;
+    int32_t fd, size, cnt, pos, i;
+
+    if (-1 == (fd = ece391_open (name))) {
+        ece391_fdputs (1, (uint8_t*)"cannot open the large text file\n");
+        return 3;
+    }
+    if (TAIL > (size = ece391_lseek (fd, 0, SEEK_END))) {
+        ece391_fdputs (1, (uint8_t*)"file too short\n");
+        return 3;
+    }
+
+    start = ece391_rdtsc ();
+    for (round = 0; round < ROUNDS; round++) {
+        ece391_close (fd);
+        ece391_open (name);
+        for (pos = 0; 0 < (cnt = ece391_read (fd, buf, BUFSIZE)); pos += cnt) {
+            for (i = 0; i < cnt; i++) {
+                if (pos + i >= size - TAIL)
+                    tail[0][pos + i - (size - TAIL)] = buf[i];
+            }
+        }
+    }
+    reread = ece391_rdtsc () - start;
+
+    start = ece391_rdtsc ();
+    for (round = 0; round < ROUNDS; round++) {
+        ece391_lseek (fd, -TAIL, SEEK_END);
+        ece391_read (fd, tail[1], TAIL);
+    }
+    seeked = ece391_rdtsc () - start;
+
+    start = ece391_rdtsc ();
+    for (round = 0; round < ROUNDS; round++)
+        ece391_pread (fd, tail[2], TAIL, size - TAIL);
+    preaded = ece391_rdtsc () - start;
+    ece391_close (fd);
+
+    for (i = 0; i < TAIL; i++) {
+        if (tail[0][i] != tail[1][i] || tail[0][i] != tail[2][i]) {
+            ece391_fdputs (1, (uint8_t*)"the three runs read different data\n");
+            return 3;
+        }
+    }
+    ece391_putnum ("reopen and read:     ", reread / ROUNDS, " cycles");
+    ece391_putnum ("lseek and read:      ", seeked / ROUNDS, " cycles");
+    ece391_putnum ("pread:               ", preaded / ROUNDS, " cycles");
+    return 0;
+}
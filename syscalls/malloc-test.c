@@ -0,0 +1,120 @@
+#include <stdint.h>
+
+#include "printf.h"
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SLOTS 1024
+#define ROUNDS 8
+
+static uint8_t *objs[SLOTS];
+static uint32_t sizes[SLOTS];
+static uint32_t seed = 391;
+
+/* The kernel allocator and the user-space fast path, behind one interface */
+typedef struct {
+    const char *name;
+    void *(*alloc) (uint32_t);
+    int32_t (*release) (void *);
+} allocator_t;
+
+static int32_t ufree_wrapper (void *ptr)
+{
+    ece391_ufree (ptr);
+    return 0;
+}
+
+static const allocator_t allocators[] = {
+    {"syscall", ece391_malloc, ece391_free},
+    {"user", ece391_umalloc, ufree_wrapper},
+};
+
+/* Small LCG so the run is the same every time */
+static uint32_t next_rand (void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/* Fill every slot, then free and reallocate random slots with random sizes,
+ * checking that no object was overwritten by a neighbour. Returns the
+ * number of malloc/free calls made, or 0 on a failed check. */
+static uint32_t stress (const allocator_t *a, uint32_t max_size)
+{
+    uint32_t i, j, k, ops = 0;
+
+    for (i = 0; i < SLOTS; i++) {
+        sizes[i] = next_rand () % max_size + 1;
+        objs[i] = a->alloc (sizes[i]);
+        ops++;
+        if (objs[i])
+            for (j = 0; j < sizes[i]; j++)
+                objs[i][j] = (uint8_t) i;
+    }
+
+    for (k = 0; k < SLOTS * ROUNDS; k++) {
+        i = next_rand () % SLOTS;
+        if (objs[i]) {
+            for (j = 0; j < sizes[i]; j++) {
+                if (objs[i][j] != (uint8_t) i) {
+                    printf ("object %d corrupted\n", i);
+                    return 0;
+                }
+            }
+            if (0 != a->release (objs[i])) {
+                printf ("free of object %d failed\n", i);
+                return 0;
+            }
+            ops++;
+        }
+        sizes[i] = next_rand () % max_size + 1;
+        objs[i] = a->alloc (sizes[i]);
+        ops++;
+        if (objs[i])
+            for (j = 0; j < sizes[i]; j++)
+                objs[i][j] = (uint8_t) i;
+    }
+
+    for (i = 0; i < SLOTS; i++) {
+        if (objs[i]) {
+            a->release (objs[i]);
+            objs[i] = 0;
+            ops++;
+        }
+    }
+    return ops;
+}
+
+int main ()
+{
+    static const uint32_t max_sizes[] = {16, 64, 200};
+    uint32_t i, k, ops, start;
+    uint8_t *all;
+
+    for (k = 0; k < sizeof (allocators) / sizeof (allocators[0]); k++) {
+        for (i = 0; i < sizeof (max_sizes) / sizeof (max_sizes[0]); i++) {
+            seed = 391;
+            start = ece391_rdtsc ();
+            ops = stress (&allocators[k], max_sizes[i]);
+            start = ece391_rdtsc () - start;
+            if (!ops)
+                return 3;
+            printf ("%s malloc, sizes 1-%d: %d calls, %d cycles/call\n",
+                    allocators[k].name, max_sizes[i], ops, start / ops);
+        }
+
+        if (k == 0) {
+            /* Everything was freed, so the kernel heap must have coalesced
+             * back into one block big enough for nearly the whole heap */
+            all = ece391_malloc (200 * 1024);
+            if (!all) {
+                printf ("heap did not coalesce\n");
+                return 3;
+            }
+            ece391_free (all);
+        }
+    }
+
+    printf ("malloc-test passed\n");
+    return 0;
+}